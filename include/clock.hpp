@@ -0,0 +1,202 @@
+/******************************************************************************/
+// Cycle-counter clock by Foster Brereton.
+//
+// Distributed under the MIT License. (See accompanying LICENSE.md or copy at
+// https://opensource.org/licenses/MIT)
+/******************************************************************************/
+
+#ifndef MUTEXPP_CLOCK_HPP__
+#define MUTEXPP_CLOCK_HPP__
+
+/******************************************************************************/
+
+// stdc++
+#include <chrono>
+#include <cstdint>
+
+#if _MSC_VER
+    #include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <cpuid.h>
+    #include <x86intrin.h>
+#endif
+
+/******************************************************************************/
+
+namespace mutexpp {
+
+/******************************************************************************/
+
+namespace detail {
+
+/******************************************************************************/
+
+inline std::int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/******************************************************************************/
+// Raw cycle counter where there is one (the TSC on x86, the generic timer on
+// ARM64), else the steady clock in nanoseconds. Reading it is a single
+// unprivileged instruction, with no vDSO call and never a syscall.
+
+inline std::uint64_t cycle_count() {
+#if (_MSC_VER && (defined(_M_IX86) || defined(_M_X64))) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__) && !_MSC_VER
+    std::uint64_t value;
+
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+
+    return value;
+#else
+    return steady_ns();
+#endif
+}
+
+/******************************************************************************/
+// Whether cycle_count() ticks at one constant rate on every core, through
+// frequency changes and idle states, so that it can stand in for a clock. On
+// x86 that is the invariant TSC bit; the ARM64 generic timer is constant-rate
+// by definition.
+
+inline bool cycle_count_invariant() {
+#if _MSC_VER && (defined(_M_IX86) || defined(_M_X64))
+    int info[4];
+
+    __cpuid(info, 0x80000000);
+
+    if (static_cast<unsigned>(info[0]) < 0x80000007)
+        return false;
+
+    __cpuid(info, 0x80000007);
+
+    return (info[3] & (1 << 8)) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+        return false;
+
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+
+    return (edx & (1u << 8)) != 0;
+#elif defined(__aarch64__) && !_MSC_VER
+    return true;
+#else
+    return false;
+#endif
+}
+
+/******************************************************************************/
+// Maps cycle_count() onto the steady clock's timeline. Measured once, at
+// startup, by spinning for calibration_ns_k against the steady clock. Each
+// steady clock read is bracketed by two counter reads and matched with their
+// midpoint, and both clocks are read once beforehand, since a first read can
+// fault in the vDSO and skew a short window badly.
+
+struct cycle_calibration_t {
+    enum : std::int64_t { calibration_ns_k = 2000000 };
+
+    bool          _valid{false};
+    std::uint64_t _cycle_origin{0};
+    std::int64_t  _ns_origin{0}; // steady_ns() at _cycle_origin
+    double        _ns_per_cycle{0};
+
+    static void sample(std::uint64_t& cycles, std::int64_t& ns) {
+        std::uint64_t before = cycle_count();
+
+        ns = steady_ns();
+        cycles = before + (cycle_count() - before) / 2;
+    }
+
+    static cycle_calibration_t measure() {
+        cycle_calibration_t result;
+
+        if (!cycle_count_invariant())
+            return result;
+
+        std::uint64_t cycle_start;
+        std::int64_t  ns_start;
+        std::uint64_t cycle_end;
+        std::int64_t  ns_end;
+
+        sample(cycle_start, ns_start);
+        sample(cycle_start, ns_start);
+
+        do {
+            sample(cycle_end, ns_end);
+        } while (ns_end - ns_start < calibration_ns_k);
+
+        if (cycle_end <= cycle_start)
+            return result;
+
+        result._valid = true;
+        result._cycle_origin = cycle_start;
+        result._ns_origin = ns_start;
+        result._ns_per_cycle = double(ns_end - ns_start) / double(cycle_end - cycle_start);
+
+        return result;
+    }
+};
+
+inline const cycle_calibration_t& cycle_calibration() {
+    static const cycle_calibration_t calibration_s = cycle_calibration_t::measure();
+
+    return calibration_s;
+}
+
+// Runs the calibration during static initialization, so the 2ms spin is paid
+// before main() rather than by whichever clock read comes first, which may be
+// one timing a held lock. Every translation unit including this header gets
+// one of these; all but the first find the calibration already done.
+struct cycle_calibration_init_t {
+    cycle_calibration_init_t() { cycle_calibration(); }
+};
+
+static const cycle_calibration_init_t cycle_calibration_init_s;
+
+/******************************************************************************/
+
+} // namespace detail
+
+/******************************************************************************/
+// A std::chrono clock read from the cycle counter and scaled to nanoseconds on
+// the steady clock's timeline. Where the counter is missing or not invariant it
+// falls back to the steady clock itself, so the two always agree on the epoch.
+
+class cycle_clock_t {
+public:
+    typedef std::chrono::nanoseconds               duration;
+    typedef duration::rep                          rep;
+    typedef duration::period                       period;
+    typedef std::chrono::time_point<cycle_clock_t> time_point;
+
+    static constexpr bool is_steady = true;
+
+    static time_point now() {
+        const detail::cycle_calibration_t& calibration = detail::cycle_calibration();
+
+        if (!calibration._valid)
+            return time_point(duration(detail::steady_ns()));
+
+        // Signed, in case this core's counter reads a hair behind the origin.
+        std::int64_t cycles = static_cast<std::int64_t>(detail::cycle_count() - calibration._cycle_origin);
+
+        return time_point(duration(calibration._ns_origin +
+                                   static_cast<std::int64_t>(cycles * calibration._ns_per_cycle)));
+    }
+
+    static bool calibrated() { return detail::cycle_calibration()._valid; }
+};
+
+/******************************************************************************/
+
+} // namespace mutexpp
+
+/******************************************************************************/
+
+#endif // MUTEXPP_CLOCK_HPP__
+
+/******************************************************************************/
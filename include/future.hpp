@@ -0,0 +1,542 @@
+/******************************************************************************/
+// Continuation-capable futures for serial queues by Foster Brereton.
+//
+// Distributed under the MIT License. (See accompanying LICENSE.md or copy at
+// https://opensource.org/licenses/MIT)
+/******************************************************************************/
+
+#ifndef MUTEXPP_FUTURE_HPP__
+#define MUTEXPP_FUTURE_HPP__
+
+/******************************************************************************/
+
+// stdc++
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// mutexpp
+#include "serial_queue.hpp"
+
+/******************************************************************************/
+
+namespace mutexpp {
+
+/******************************************************************************/
+
+template <typename T>
+class future;
+
+template <typename T>
+class promise;
+
+/******************************************************************************/
+
+namespace detail {
+
+/******************************************************************************/
+// Stands in for the value of a future<void>, so the shared state need not be
+// specialized.
+
+struct unit_t { };
+
+template <typename T>
+struct stored {
+    typedef T type;
+};
+
+template <>
+struct stored<void> {
+    typedef unit_t type;
+};
+
+/******************************************************************************/
+// The state shared by a promise and its future. Unlike std::future's it can
+// hold one continuation, which runs on the thread that makes the state ready
+// (or immediately, if it already is). A thread only parks on the condition
+// variable if someone actually calls wait() or get().
+
+template <typename T>
+class future_state_t {
+public:
+    typedef typename stored<T>::type value_type;
+
+private:
+    typedef std::unique_lock<std::mutex> lock_t;
+
+    std::mutex                                                                  _mutex;
+    std::condition_variable                                                     _ready;
+    bool                                                                        _done{false};
+    bool                                                                        _waiting{false};
+    bool                                                                        _has_value{false};
+    std::exception_ptr                                                          _error;
+    std::function<void()>                                                       _continuation;
+    typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type _storage;
+
+    value_type& value() {
+        return *reinterpret_cast<value_type*>(&_storage);
+    }
+
+    void satisfy_check() const {
+        if (_done)
+            throw std::future_error(std::future_errc::promise_already_satisfied);
+    }
+
+    // The continuation is moved out before it runs, which also breaks the
+    // reference cycle between it and the state it is attached to.
+    void complete(lock_t& lock) {
+        std::function<void()> continuation;
+
+        continuation.swap(_continuation);
+
+        _done = true;
+
+        bool waiting{_waiting};
+
+        lock.unlock();
+
+        if (waiting)
+            _ready.notify_all();
+
+        if (continuation)
+            continuation();
+    }
+
+public:
+    future_state_t() = default;
+
+    future_state_t(const future_state_t&) = delete;
+    future_state_t& operator=(const future_state_t&) = delete;
+
+    ~future_state_t() {
+        if (_has_value)
+            value().~value_type();
+    }
+
+    template <typename... Args>
+    void set_value(Args&&... args) {
+        lock_t lock(_mutex);
+
+        satisfy_check();
+
+        new (&_storage) value_type(std::forward<Args>(args)...);
+
+        _has_value = true;
+
+        complete(lock);
+    }
+
+    void set_exception(std::exception_ptr error) {
+        lock_t lock(_mutex);
+
+        satisfy_check();
+
+        _error = std::move(error);
+
+        complete(lock);
+    }
+
+    // Called when the promise goes away; a no-op if it kept its word.
+    void abandon() {
+        lock_t lock(_mutex);
+
+        if (_done)
+            return;
+
+        _error = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+
+        complete(lock);
+    }
+
+    void then(std::function<void()> continuation) {
+        lock_t lock(_mutex);
+
+        if (!_done) {
+            _continuation = std::move(continuation);
+
+            return;
+        }
+
+        lock.unlock();
+
+        continuation();
+    }
+
+    bool ready() {
+        lock_t lock(_mutex);
+
+        return _done;
+    }
+
+    void wait() {
+        lock_t lock(_mutex);
+
+        _waiting = true;
+
+        _ready.wait(lock, [&](){ return _done; });
+    }
+
+    value_type take() {
+        wait();
+
+        if (_error)
+            std::rethrow_exception(_error);
+
+        return std::move(value());
+    }
+};
+
+/******************************************************************************/
+
+template <typename F, typename T, typename... Extra>
+struct then_result {
+    typedef decltype(std::declval<F&>()(std::declval<Extra&>()..., std::declval<T>())) type;
+};
+
+template <typename F, typename... Extra>
+struct then_result<F, void, Extra...> {
+    typedef decltype(std::declval<F&>()(std::declval<Extra&>()...)) type;
+};
+
+// Calls f with any extra (resource) arguments first, then the stored value,
+// if there is one.
+template <typename F, typename V, typename... Extra>
+auto invoke_stored(F& f, V&& v, Extra&... extra) -> decltype(f(extra..., std::forward<V>(v))) {
+    return f(extra..., std::forward<V>(v));
+}
+
+template <typename F, typename... Extra>
+auto invoke_stored(F& f, unit_t, Extra&... extra) -> decltype(f(extra...)) {
+    return f(extra...);
+}
+
+template <typename R>
+struct fulfill_t {
+    template <typename F, typename V, typename... Extra>
+    static void run(future_state_t<R>& target, F& f, V&& v, Extra&... extra) {
+        target.set_value(invoke_stored(f, std::forward<V>(v), extra...));
+    }
+};
+
+template <>
+struct fulfill_t<void> {
+    template <typename F, typename V, typename... Extra>
+    static void run(future_state_t<void>& target, F& f, V&& v, Extra&... extra) {
+        invoke_stored(f, std::forward<V>(v), extra...);
+
+        target.set_value();
+    }
+};
+
+// Runs f on whatever source resolved to, and resolves target with the
+// outcome. An exception in source skips f and passes straight through.
+template <typename R, typename T, typename F, typename... Extra>
+void settle(future_state_t<R>& target, future_state_t<T>& source, F& f, Extra&... extra) {
+    try {
+        fulfill_t<R>::run(target, f, source.take(), extra...);
+    } catch (...) {
+        target.set_exception(std::current_exception());
+    }
+}
+
+// As settle, for a task with no upstream value.
+template <typename R, typename F, typename... Extra>
+void produce(future_state_t<R>& target, F& f, Extra&... extra) {
+    try {
+        fulfill_t<R>::run(target, f, unit_t(), extra...);
+    } catch (...) {
+        target.set_exception(std::current_exception());
+    }
+}
+
+/******************************************************************************/
+
+struct future_access_t {
+    template <typename T>
+    static const std::shared_ptr<future_state_t<T>>& state(const future<T>& f) {
+        return f._state;
+    }
+
+    template <typename T>
+    static future<T> make(std::shared_ptr<future_state_t<T>> state) {
+        return future<T>(std::move(state));
+    }
+};
+
+/******************************************************************************/
+
+template <typename T>
+struct when_all_result {
+    typedef std::vector<T> type;
+};
+
+template <>
+struct when_all_result<void> {
+    typedef void type;
+};
+
+// Gathers the inputs' outcomes once the last of them is ready. The first
+// exception, in input order, wins.
+template <typename T>
+struct when_all_t {
+    typedef typename when_all_result<T>::type result_type;
+
+    std::vector<future<T>>                       _inputs;
+    std::atomic<std::size_t>                     _remaining;
+    std::shared_ptr<future_state_t<result_type>> _target;
+
+    when_all_t(std::vector<future<T>>&& inputs) :
+        _inputs(std::move(inputs)),
+        _remaining(_inputs.size()),
+        _target(std::make_shared<future_state_t<result_type>>()) {
+    }
+
+    void gather(std::true_type /* void */) {
+        for (auto& input : _inputs)
+            input.get();
+
+        _target->set_value();
+    }
+
+    void gather(std::false_type /* void */) {
+        result_type result;
+
+        result.reserve(_inputs.size());
+
+        for (auto& input : _inputs)
+            result.push_back(input.get());
+
+        _target->set_value(std::move(result));
+    }
+
+    void finish() {
+        try {
+            gather(typename std::is_void<T>::type());
+        } catch (...) {
+            _target->set_exception(std::current_exception());
+        }
+    }
+};
+
+/******************************************************************************/
+
+} // namespace detail
+
+/******************************************************************************/
+// A single-consumer future like std::future, but one that can be chained:
+// then() runs a continuation on a serial queue (or against a serial_wrapper's
+// resource) once the value is ready, and returns a future of its result. No
+// thread blocks along the way unless get() or wait() is called.
+
+template <typename T>
+class future {
+    friend struct detail::future_access_t;
+
+    typedef detail::future_state_t<T> state_type;
+
+    std::shared_ptr<state_type> _state;
+
+    explicit future(std::shared_ptr<state_type> state) : _state(std::move(state)) { }
+
+    std::shared_ptr<state_type> release() {
+        if (!_state)
+            throw std::future_error(std::future_errc::no_state);
+
+        return std::move(_state);
+    }
+
+public:
+    typedef T value_type;
+
+    future() = default;
+    future(future&&) = default;
+    future& operator=(future&&) = default;
+
+    future(const future&) = delete;
+    future& operator=(const future&) = delete;
+
+    bool valid() const { return static_cast<bool>(_state); }
+
+    bool is_ready() const { return _state->ready(); }
+
+    void wait() const { _state->wait(); }
+
+    // Blocks until ready; leaves the future invalid.
+    T get() {
+        std::shared_ptr<state_type> state(release());
+
+        return static_cast<T>(state->take());
+    }
+
+    // Runs f(value) on queue once this future is ready. Leaves this future
+    // invalid.
+    template <typename F>
+    future<typename detail::then_result<F, T>::type> then(serial_queue_t& queue, F f) {
+        typedef typename detail::then_result<F, T>::type result_type;
+
+        std::shared_ptr<state_type> source(release());
+        serial_queue_t*             q(&queue);
+        auto                        target = std::make_shared<detail::future_state_t<result_type>>();
+
+        source->then([source, target, q, f](){
+            q->execute([source, target, f]() mutable {
+                detail::settle(*target, *source, f);
+            });
+        });
+
+        return detail::future_access_t::make(std::move(target));
+    }
+
+    // Runs f(resource, value) on the wrapper's queue once this future is
+    // ready. Leaves this future invalid.
+    template <typename U, typename F>
+    future<typename detail::then_result<F, T, U>::type> then(serial_wrapper<U>& wrapper, F f) {
+        typedef typename detail::then_result<F, T, U>::type result_type;
+
+        std::shared_ptr<state_type> source(release());
+        serial_wrapper<U>*          w(&wrapper);
+        auto                        target = std::make_shared<detail::future_state_t<result_type>>();
+
+        source->then([source, target, w, f](){
+            w->post([source, target, f](U& resource) mutable {
+                detail::settle(*target, *source, f, resource);
+            });
+        });
+
+        return detail::future_access_t::make(std::move(target));
+    }
+};
+
+/******************************************************************************/
+
+template <typename T>
+class promise {
+    std::shared_ptr<detail::future_state_t<T>> _state;
+    bool                                       _retrieved{false};
+
+public:
+    promise() : _state(std::make_shared<detail::future_state_t<T>>()) { }
+
+    promise(promise&& x) noexcept :
+        _state(std::move(x._state)),
+        _retrieved(x._retrieved) {
+    }
+
+    promise& operator=(promise&& x) noexcept {
+        promise(std::move(x)).swap(*this);
+
+        return *this;
+    }
+
+    promise(const promise&) = delete;
+    promise& operator=(const promise&) = delete;
+
+    ~promise() {
+        if (_state)
+            _state->abandon();
+    }
+
+    void swap(promise& x) noexcept {
+        std::swap(_state, x._state);
+        std::swap(_retrieved, x._retrieved);
+    }
+
+    future<T> get_future() {
+        if (!_state)
+            throw std::future_error(std::future_errc::no_state);
+
+        if (_retrieved)
+            throw std::future_error(std::future_errc::future_already_retrieved);
+
+        _retrieved = true;
+
+        return detail::future_access_t::make(_state);
+    }
+
+    template <typename... Args>
+    void set_value(Args&&... args) {
+        _state->set_value(std::forward<Args>(args)...);
+    }
+
+    void set_exception(std::exception_ptr error) {
+        _state->set_exception(std::move(error));
+    }
+};
+
+/******************************************************************************/
+// Runs f() on queue, returning a chainable future of its result.
+
+template <typename F>
+future<typename detail::then_result<F, void>::type> submit(serial_queue_t& queue, F f) {
+    typedef typename detail::then_result<F, void>::type result_type;
+
+    auto target = std::make_shared<detail::future_state_t<result_type>>();
+
+    queue.execute([target, f]() mutable {
+        detail::produce(*target, f);
+    });
+
+    return detail::future_access_t::make(std::move(target));
+}
+
+// Runs f(resource) on the wrapper's queue, returning a chainable future of
+// its result.
+
+template <typename U, typename F>
+future<typename detail::then_result<F, void, U>::type> submit(serial_wrapper<U>& wrapper, F f) {
+    typedef typename detail::then_result<F, void, U>::type result_type;
+
+    auto target = std::make_shared<detail::future_state_t<result_type>>();
+
+    wrapper.post([target, f](U& resource) mutable {
+        detail::produce(*target, f, resource);
+    });
+
+    return detail::future_access_t::make(std::move(target));
+}
+
+/******************************************************************************/
+// A future that is ready once all of futures are, holding their values in
+// order (or nothing, for void). The gathering runs on whichever thread
+// readies the last input.
+
+template <typename T>
+future<typename detail::when_all_result<T>::type> when_all(std::vector<future<T>> futures) {
+    typedef detail::when_all_t<T> aggregate_type;
+
+    auto aggregate = std::make_shared<aggregate_type>(std::move(futures));
+    auto result = detail::future_access_t::make(aggregate->_target);
+
+    if (aggregate->_inputs.empty()) {
+        aggregate->finish();
+
+        return result;
+    }
+
+    for (const auto& input : aggregate->_inputs) {
+        detail::future_access_t::state(input)->then([aggregate](){
+            if (aggregate->_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                aggregate->finish();
+        });
+    }
+
+    return result;
+}
+
+/******************************************************************************/
+
+} // namespace mutexpp
+
+/******************************************************************************/
+
+#endif // MUTEXPP_FUTURE_HPP__
+
+/******************************************************************************/
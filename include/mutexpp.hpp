@@ -10,8 +10,41 @@
 
 /******************************************************************************/
 
+#include <algorithm>
 #include <atomic>
+#include <bitset>
 #include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if _MSC_VER
+    #include <intrin.h>
+#endif
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+    #define MUTEXPP_HAS_COROUTINES 1
+    #include <coroutine>
+#else
+    #define MUTEXPP_HAS_COROUTINES 0
+#endif
+
+#if __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+// mutexpp
+#include "clock.hpp"
+#include "trace.hpp"
 
 /******************************************************************************/
 
@@ -19,151 +52,2204 @@ namespace mutexpp {
 
 /******************************************************************************/
 
-using clock_t = std::chrono::high_resolution_clock;
+// The clock behind every timing decision the mutexes make, and the probes'
+// measurements: a calibrated cycle counter where one is usable, since
+// high_resolution_clock can cost a vDSO call or worse on virtual machines.
+using clock_t = cycle_clock_t;
 using tp_t = clock_t::time_point;
 using diff_t = decltype((std::declval<tp_t>() - std::declval<tp_t>()).count());
 
-#if MUTEXPP_ENABLE_PROBE
 using duration_t = std::chrono::duration<double, std::micro>;
 using probe_t = void (*)(bool        did_block,
                          std::size_t spin_count,
-                         duration_t  block_count);
-#endif
+                         duration_t  wait_time);
+
+// Snapshot of a mutex's contention statistics, as returned by stats_probe_t's
+// stats(). Only acquisitions through lock() are counted. Histogram bucket i
+// counts durations in [2^i, 2^(i+1)) nanoseconds (bucket 0 also takes 0ns, the
+// last bucket everything beyond). Hold times are sampled, one acquisition in
+// hold_sample_k per thread.
+struct lock_stats_t {
+    enum : std::size_t {
+        bucket_count_k = 32,
+        hold_sample_k = 64
+    };
+
+    std::uint64_t _acquisitions{0};
+    std::uint64_t _contended{0};    // acquisitions that did not succeed outright
+    std::uint64_t _spins{0};        // spin iterations over contended acquisitions
+    std::uint64_t _blocks{0};       // acquisitions that slept or parked
+    std::uint64_t _wait_ns[bucket_count_k]{}; // contended acquisitions only
+    std::uint64_t _hold_ns[bucket_count_k]{};
+};
 
 /******************************************************************************/
 
-class spin_mutex_t {
-private:
-    std::atomic_flag _lock = ATOMIC_FLAG_INIT;
+namespace detail {
+
+/******************************************************************************/
+// What a thread publishes about itself for owner-aware spinning. User space
+// cannot see whether another thread is on a CPU, so the record carries the
+// part the thread knows: whether it is currently parked or sleeping in one of
+// our waits. Records are recycled when threads exit but never freed, so a
+// stale pointer to one is always safe to read. Recycling also keeps _index
+// dense: it stays below the most threads ever alive at once.
+
+struct thread_record_t {
+    std::atomic<std::uint32_t> _parked{0};
+    thread_record_t*           _free_next{nullptr};
+    const std::uint32_t        _index;
+
+    explicit thread_record_t(std::uint32_t index) : _index(index) { }
+};
+
+class thread_record_registry_t {
+    std::atomic_flag _lock = ATOMIC_FLAG_INIT; // taken once per thread start and exit
+    thread_record_t* _free{nullptr};
+    std::uint32_t    _record_count{0};
+
+    void lock() {
+        while (_lock.test_and_set(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    void unlock() { _lock.clear(std::memory_order_release); }
 
 public:
-#if MUTEXPP_ENABLE_PROBE
-    probe_t _probe{nullptr};
-#endif
+    thread_record_t* acquire() {
+        lock();
 
-    bool try_lock() {
-        return !_lock.test_and_set(std::memory_order_acquire);
+        thread_record_t* result = _free;
+        std::uint32_t    index{0};
+
+        if (result)
+            _free = result->_free_next;
+        else
+            index = _record_count++;
+
+        unlock();
+
+        return result ? result : new thread_record_t(index);
     }
 
-    void lock() {
-        std::size_t spin_count{0};
+    void release(thread_record_t* record) {
+        record->_parked.store(0, std::memory_order_relaxed);
 
-        while (!try_lock()) { ++spin_count; }
+        lock();
 
-#if MUTEXPP_ENABLE_PROBE
-        if (_probe) {
-            static const duration_t zero_k{std::chrono::duration_cast<duration_t>(tp_t::duration(0))};
+        record->_free_next = _free;
+        _free = record;
 
-            _probe(false, spin_count, zero_k);
-        }
+        unlock();
+    }
+};
+
+inline thread_record_registry_t& thread_record_registry() {
+    static thread_record_registry_t* registry_s = new thread_record_registry_t(); // outlives every thread
+
+    return *registry_s;
+}
+
+inline thread_record_t& this_thread_record() {
+    struct holder_t {
+        thread_record_t* _record{thread_record_registry().acquire()};
+
+        ~holder_t() { thread_record_registry().release(_record); }
+    };
+
+    thread_local holder_t holder_s;
+
+    return *holder_s._record;
+}
+
+// Marks the calling thread parked while in scope.
+class parked_scope_t {
+    thread_record_t& _record{this_thread_record()};
+
+public:
+    parked_scope_t() { _record._parked.store(1, std::memory_order_relaxed); }
+    ~parked_scope_t() { _record._parked.store(0, std::memory_order_relaxed); }
+
+    parked_scope_t(const parked_scope_t&) = delete;
+    parked_scope_t& operator=(const parked_scope_t&) = delete;
+};
+
+/******************************************************************************/
+// Minimal futex-style parking primitives. futex_wait blocks the caller for as
+// long as word == expected, and may return spuriously, so callers must always
+// re-check their condition in a loop. Platforms without a futex fall back to
+// yielding, which stays correct but degrades to polling. A thread in
+// futex_wait is marked parked in its thread_record_t.
+
+using futex_word_t = std::atomic<std::uint32_t>;
+
+static_assert(sizeof(futex_word_t) == sizeof(std::uint32_t),
+              "futex_word_t must be layout-compatible with a 32-bit futex");
+
+inline void futex_wait(futex_word_t& word, std::uint32_t expected) {
+    parked_scope_t parked;
+
+#if __linux__
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+              FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    if (word.load(std::memory_order_relaxed) == expected)
+        std::this_thread::yield();
+#endif
+}
+
+inline void futex_wake(futex_word_t& word, int count) {
+#if __linux__
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+              FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+    (void)word;
+    (void)count;
+#endif
+}
+
+/******************************************************************************/
+
+enum : std::size_t { cache_line_k = 64 };
+
+/******************************************************************************/
+// Architecture hint that the caller is busy-waiting. On x86 this is PAUSE, which
+// also avoids the memory-order mis-speculation penalty when the spin ends; on
+// ARM it is YIELD.
+
+inline void cpu_relax() {
+#if _MSC_VER && (defined(_M_IX86) || defined(_M_X64))
+    _mm_pause();
+#elif _MSC_VER && (defined(_M_ARM) || defined(_M_ARM64))
+    __yield();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
 #endif
+}
+
+/******************************************************************************/
+// Cheap per-thread xorshift32, used to de-synchronize backoff among waiters.
+// Not remotely suitable for anything but jitter.
+
+inline std::uint32_t jitter() {
+    thread_local std::uint32_t state_s{0};
+
+    if (!state_s)
+        state_s = static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(&state_s)) | 1;
+
+    state_s ^= state_s << 13;
+    state_s ^= state_s >> 17;
+    state_s ^= state_s << 5;
+
+    return state_s;
+}
+
+/******************************************************************************/
+// p_{n+1} = p_n + (m - p_n) / 2^shift, computed without unsigned wraparound
+// when the measurement falls below the prediction. See the readme for the
+// derivation.
+
+inline std::size_t ema_update(std::size_t p, std::size_t m, std::size_t shift = 3) {
+    return m > p ? p + ((m - p) >> shift) : p - ((p - m) >> shift);
+}
+
+/******************************************************************************/
+// What giving up the CPU by sleeping costs on this machine: the fastest of a
+// few 1us sleeps, the wait policy::sleep_wait_t makes. Timer slack and the
+// scheduler stretch it well past 1us, by different amounts on different
+// machines. This is deliberately not a futex park and wake, which is cheaper:
+// a waiter that stops spinning under sleep_wait_t pays for the sleep.
+// Measured once, at startup, as the cycle clock is calibrated.
+
+inline tp_t::duration sleep_cost() {
+    enum : int { sample_count_k = 8 };
+
+    static const tp_t::duration sleep_cost_s = [](){
+        tp_t::duration result = tp_t::duration::max();
+
+        for (int i(0); i < sample_count_k; ++i) {
+            tp_t start = clock_t::now();
+
+            std::this_thread::sleep_for(std::chrono::microseconds(1));
+
+            result = (std::min)(result, clock_t::now() - start);
+        }
+
+        return result;
+    }();
+
+    return sleep_cost_s;
+}
+
+struct sleep_cost_init_t {
+    sleep_cost_init_t() { sleep_cost(); }
+};
+
+static const sleep_cost_init_t sleep_cost_init_s;
+
+/******************************************************************************/
+// Queue node for mcs_mutex_t. Each waiter spins on its own node, so nodes are
+// cache-line aligned to keep one waiter's spinning off of another's line.
+
+struct alignas(cache_line_k) mcs_node_t {
+    std::atomic<mcs_node_t*> _next{nullptr};
+    std::atomic<bool>        _locked{false};
+    mcs_node_t*              _free_next{nullptr};
+};
+
+/******************************************************************************/
+// Per-thread free list of MCS nodes. A node is only referenced by other threads
+// while its owner is queued for or holding a lock, so it can be recycled as
+// soon as unlock() has handed off to the successor. Nodes are carved out of
+// manually aligned blocks since C++11 operator new ignores over-alignment.
+
+class mcs_node_pool_t {
+    enum : std::size_t { block_count_k = 8 };
+
+    mcs_node_t*        _free{nullptr};
+    std::vector<void*> _blocks;
+
+    void grow() {
+        void*       raw = ::operator new(block_count_k * sizeof(mcs_node_t) + cache_line_k);
+        std::size_t offset = cache_line_k - reinterpret_cast<std::uintptr_t>(raw) % cache_line_k;
+        mcs_node_t* first = reinterpret_cast<mcs_node_t*>(static_cast<char*>(raw) + offset);
+
+        _blocks.push_back(raw);
+
+        for (std::size_t i(0); i < block_count_k; ++i)
+            release(new (first + i) mcs_node_t());
     }
 
-    void unlock() {
-        _lock.clear(std::memory_order_release);
+public:
+    mcs_node_pool_t() = default;
+    mcs_node_pool_t(const mcs_node_pool_t&) = delete;
+    mcs_node_pool_t& operator=(const mcs_node_pool_t&) = delete;
+
+    ~mcs_node_pool_t() {
+        for (auto& raw : _blocks)
+            ::operator delete(raw);
+    }
+
+    mcs_node_t* acquire() {
+        if (!_free)
+            grow();
+
+        mcs_node_t* result = _free;
+
+        _free = result->_free_next;
+
+        result->_next.store(nullptr, std::memory_order_relaxed);
+        result->_locked.store(true, std::memory_order_relaxed);
+
+        return result;
+    }
+
+    void release(mcs_node_t* node) {
+        node->_free_next = _free;
+        _free = node;
     }
 };
 
+inline mcs_node_pool_t& mcs_node_pool() {
+    thread_local mcs_node_pool_t pool_s;
+
+    return pool_s;
+}
+
 /******************************************************************************/
+// Marks the start of a wait, but only once the wait actually starts, so
+// uncontended acquisitions never read the clock.
 
-class adaptive_spin_mutex_t {
-private:
-    std::atomic_flag         _lock = ATOMIC_FLAG_INIT;
-    std::atomic<std::size_t> _spin_pred{0};
+class timed_wait_t {
+    tp_t _start;
+    bool _started{false};
 
 public:
-#if MUTEXPP_ENABLE_PROBE
-    probe_t _probe{nullptr};
-#endif
+    template <typename Probe>
+    explicit timed_wait_t(Probe&) { }
 
-    bool try_lock() {
-        return !_lock.test_and_set(std::memory_order_acquire);
+    void start() {
+        if (_started)
+            return;
+
+        _started = true;
+        _start = clock_t::now();
     }
 
-    void lock() {
-#if MUTEXPP_ENABLE_PROBE
-        bool   did_block{false};
-#endif
-        std::size_t spin_count{0};
+    bool started() const { return _started; }
 
-        while (!try_lock()) {
-            ++spin_count;
+    tp_t::duration elapsed() const { return clock_t::now() - _start; }
+};
 
-            if (spin_count < _spin_pred * 2)
-                continue;
+/******************************************************************************/
 
-            // REVISIT (fbrereto) : Iff sleep_for is guaranteed to block even
-            // when the duration is 0, then std::chrono::nanoseconds(0) will
-            // suffice here.
-            std::this_thread::sleep_for(std::chrono::microseconds(1));
+inline std::size_t log2_bucket(std::uint64_t ns) {
+    std::size_t bucket{0};
 
-#if MUTEXPP_ENABLE_PROBE
-            did_block = true;
-#endif
+    while (ns >>= 1)
+        ++bucket;
+
+    return (std::min)(bucket, std::size_t(lock_stats_t::bucket_count_k - 1));
+}
+
+/******************************************************************************/
+// Per-mutex statistics. Every update happens while the mutex is held, so the
+// counters never need an RMW: a relaxed load and store is enough, and keeps
+// the cost to a few nanoseconds. The atomics only make concurrent stats()
+// calls well-defined. The block sits ahead of the mutex state and ends with a
+// cache line of padding, so bumping counters does not disturb threads polling
+// the lock word.
+
+class lock_stats_block_t {
+    typedef std::atomic<std::uint64_t> counter_t;
+
+    counter_t _acquisitions{0};
+    counter_t _contended{0};
+    counter_t _spins{0};
+    counter_t _blocks{0};
+    counter_t _wait_ns[lock_stats_t::bucket_count_k];
+    counter_t _hold_ns[lock_stats_t::bucket_count_k];
+    tp_t      _hold_start;         // holder only
+    bool      _hold_sampled{false}; // holder only
+    char      _pad[cache_line_k];
+
+    static void bump(counter_t& counter, std::uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+public:
+    lock_stats_block_t() {
+        for (std::size_t i(0); i < lock_stats_t::bucket_count_k; ++i) {
+            _wait_ns[i].store(0, std::memory_order_relaxed);
+            _hold_ns[i].store(0, std::memory_order_relaxed);
         }
+    }
+
+    lock_stats_block_t(const lock_stats_block_t&) = delete;
+    lock_stats_block_t& operator=(const lock_stats_block_t&) = delete;
+
+    // Call with the lock held, at the end of lock().
+    void acquired(std::size_t spin_count, bool did_block, const timed_wait_t& wait) {
+        thread_local std::uint32_t sample_s{0};
+
+        bump(_acquisitions);
 
-        _spin_pred += (spin_count - _spin_pred) / 8;
+        if (wait.started()) {
+            auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(wait.elapsed());
 
-#if MUTEXPP_ENABLE_PROBE
-        if (_probe) {
-            static const duration_t zero_k{std::chrono::duration_cast<duration_t>(tp_t::duration(0))};
-            _probe(did_block, _spin_pred, zero_k);
+            bump(_contended);
+            bump(_spins, spin_count);
+            bump(_wait_ns[log2_bucket(waited.count())]);
         }
-#endif
+
+        if (did_block)
+            bump(_blocks);
+
+        _hold_sampled = ++sample_s % lock_stats_t::hold_sample_k == 0;
+
+        if (_hold_sampled)
+            _hold_start = clock_t::now();
     }
 
-    void unlock() {
-        _lock.clear(std::memory_order_release);
+    // Call with the lock still held, at the start of unlock().
+    void releasing() {
+        if (!_hold_sampled)
+            return;
+
+        _hold_sampled = false;
+
+        auto held = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - _hold_start);
+
+        bump(_hold_ns[log2_bucket(held.count())]);
+    }
+
+    lock_stats_t snapshot() const {
+        lock_stats_t result;
+
+        result._acquisitions = _acquisitions.load(std::memory_order_relaxed);
+        result._contended = _contended.load(std::memory_order_relaxed);
+        result._spins = _spins.load(std::memory_order_relaxed);
+        result._blocks = _blocks.load(std::memory_order_relaxed);
+
+        for (std::size_t i(0); i < lock_stats_t::bucket_count_k; ++i) {
+            result._wait_ns[i] = _wait_ns[i].load(std::memory_order_relaxed);
+            result._hold_ns[i] = _hold_ns[i].load(std::memory_order_relaxed);
+        }
+
+        return result;
     }
 };
 
 /******************************************************************************/
 
-class adaptive_block_mutex_t {
-private:
-    std::atomic_flag    _lock = ATOMIC_FLAG_INIT;
-    std::atomic<diff_t> _lock_pred{0};
-    tp_t                _lock_start;
+} // namespace detail
+
+/******************************************************************************/
+// Probe policies. Every mutex derives publicly from its Probe, so whatever the
+// policy exposes (_probe, stats()) is reachable through the mutex, and an
+// empty policy costs neither space nor branches. A policy provides:
+//
+//   wait_t          constructed from the probe at the top of lock(); its
+//                   start() is called on every failed attempt to acquire
+//   on_acquired()   (spin_count, did_block, wait), with the lock held, at the
+//                   end of lock()
+//   on_releasing()  with the lock still held, at the start of unlock()
+//
+// try_lock() is not reported. A mutex type M built on one policy names the
+// same mutex on another as M::rebind_probe<P>, so a handful of hot locks can
+// be instrumented while the rest of the program stays untouched.
+
+// The default: every hook is an empty inline function, leaving exactly the
+// uninstrumented mutex.
+class null_probe_t {
+public:
+    struct wait_t {
+        explicit wait_t(null_probe_t&) { }
+
+        void start() { }
+    };
+
+protected:
+    void on_acquired(std::size_t, bool, const wait_t&) { }
+    void on_releasing() { }
+};
 
+// Calls _probe, when set, at the end of every lock().
+class function_probe_t {
 public:
-#if MUTEXPP_ENABLE_PROBE
+    typedef detail::timed_wait_t wait_t;
+
     probe_t _probe{nullptr};
-#endif
 
-    bool try_lock() {
-        return !_lock.test_and_set(std::memory_order_acquire);
+protected:
+    void on_acquired(std::size_t spin_count, bool did_block, const wait_t& wait) {
+        if (!_probe)
+            return;
+
+        _probe(did_block,
+               spin_count,
+               wait.started() ? std::chrono::duration_cast<duration_t>(wait.elapsed()) : duration_t(0));
     }
 
-    void lock() {
-#if MUTEXPP_ENABLE_PROBE
-        bool did_block{false};
-#endif
+    void on_releasing() { }
+};
 
-        while (!try_lock()) {
-            std::this_thread::sleep_for(tp_t::duration(_lock_pred));
+// Contention counters and wait/hold histograms, read back with stats().
+class stats_probe_t {
+    detail::lock_stats_block_t _stats;
 
-#if MUTEXPP_ENABLE_PROBE
-            did_block = true;
-#endif
+public:
+    typedef detail::timed_wait_t wait_t;
+
+    lock_stats_t stats() const { return _stats.snapshot(); }
+
+protected:
+    void on_acquired(std::size_t spin_count, bool did_block, const wait_t& wait) {
+        _stats.acquired(spin_count, did_block, wait);
+    }
+
+    void on_releasing() { _stats.releasing(); }
+};
+
+// Records waits, acquisitions and releases in the calling thread's trace ring
+// (see trace.hpp). The probe's address stands for the mutex in the trace.
+// try_lock() acquisitions are not reported, so neither are their releases;
+// every release in the trace closes an acquisition.
+class trace_probe_t {
+    bool _recorded{false}; // holder only
+
+public:
+    class wait_t {
+        const void* _object;
+        bool        _started{false};
+
+    public:
+        explicit wait_t(trace_probe_t& probe) : _object(&probe) { }
+
+        void start() {
+            if (_started)
+                return;
+
+            _started = true;
+
+            trace::record(trace::lock_wait_k, _object);
         }
+    };
 
-#if MUTEXPP_ENABLE_PROBE
-        if (_probe)
-            _probe(did_block,
-                   0,
-                   std::chrono::duration_cast<duration_t>(tp_t::duration(_lock_pred)));
-#endif
+protected:
+    void on_acquired(std::size_t, bool, const wait_t&) {
+        _recorded = true;
 
-        _lock_start = clock_t::now();
+        trace::record(trace::lock_acquire_k, this);
     }
 
-    void unlock() {
-        _lock_pred += ((clock_t::now() - _lock_start).count() - _lock_pred) / 8;
+    void on_releasing() {
+        if (!_recorded)
+            return;
+
+        _recorded = false;
+
+        trace::record(trace::lock_release_k, this);
+    }
+};
+
+/******************************************************************************/
+
+namespace detail {
 
-        _lock.clear(std::memory_order_release);
+/******************************************************************************/
+// The state behind every Spin policy. It is a futex word so that
+// policy::futex_wait_t can park on it whichever way it is acquired. locked_k
+// is the lock itself; waiters_k is only ever set by a waiter about to park,
+// and locked_k | waiters_k is the contended state of adaptive_futex_mutex_t.
+// Spin policies only ever set locked_k, so they never erase a waiter's mark.
+
+struct lock_word_t {
+    enum : std::uint32_t {
+        unlocked_k = 0,
+        locked_k = 1,
+        waiters_k = 2 // a waiter may be parked
+    };
+
+    futex_word_t _word{unlocked_k};
+
+    futex_word_t& word() { return _word; }
+
+    void unlock() { _word.store(unlocked_k, std::memory_order_release); }
+
+    // As unlock(), but reports whether a waiter may be parked, from the same
+    // RMW that releases the lock, so nothing is read after the release.
+    bool unlock_contended() {
+        return _word.exchange(unlocked_k, std::memory_order_release) & waiters_k;
+    }
+};
+
+/******************************************************************************/
+
+} // namespace detail
+
+/******************************************************************************/
+
+namespace policy {
+
+/******************************************************************************/
+// Policies for basic_mutex. Each dimension is independent, so any combination
+// compiles; the harness sweeps them to find the best fit for a workload.
+//
+//   Spin       the lock word and how an acquisition attempt touches it:
+//              try_lock(), unlock(), word()
+//   Backoff    pauses after each failed attempt: static pause(attempt)
+//   Wait       what a waiter does between attempts once the predictor's spin
+//              limit is used up: wait(word, spin_count, spin_limit, predictor)
+//              returns whether the thread gave up the CPU; release(spin)
+//              unlocks the Spin policy and wakes a waiter if one is parked
+//   Predictor  spin_limit() and sleep_time() for the Wait policy, fed by
+//              acquired(spin_count, did_block) and releasing(), both called
+//              with the lock held; spin_limit() is read once per contended
+//              lock(), at its first failed attempt
+
+/******************************************************************************/
+// Spin policies.
+
+// Test-and-set: every attempt is an atomic or of locked_k (a bit test-and-set
+// on x86).
+struct tas_t : detail::lock_word_t {
+    bool try_lock() {
+        return !(_word.fetch_or(locked_k, std::memory_order_acquire) & locked_k);
+    }
+};
+
+// Test-and-test-and-set: an attempt on a word that looks held is a plain
+// load, so waiters keep the line shared until it is released.
+struct ttas_t : detail::lock_word_t {
+    bool try_lock() {
+        return !(_word.load(std::memory_order_relaxed) & locked_k) &&
+               !(_word.fetch_or(locked_k, std::memory_order_acquire) & locked_k);
+    }
+};
+
+/******************************************************************************/
+// Backoff policies. attempt counts failed attempts in this lock(), from 1.
+
+struct no_backoff_t {
+    static void pause(std::size_t) { }
+};
+
+// A randomized delay in [b/2, b) pauses, b doubling per attempt from 4 to 1024,
+// as ttas_spin_mutex_t does.
+struct exponential_backoff_t {
+    enum : std::uint32_t {
+        backoff_min_k = 4,
+        backoff_max_k = 1024
+    };
+
+    static void pause(std::size_t attempt) {
+        std::uint32_t backoff = attempt > 8 ? backoff_max_k : backoff_min_k << (attempt - 1);
+        std::uint32_t delay{backoff / 2 + detail::jitter() % (backoff / 2)};
+
+        for (std::uint32_t i(0); i < delay; ++i)
+            detail::cpu_relax();
+    }
+};
+
+// A delay growing linearly with the attempt count. Without tickets there is no
+// queue position to be proportional to, so the attempt count stands in for
+// how crowded the lock is.
+struct proportional_backoff_t {
+    enum : std::uint32_t {
+        backoff_per_attempt_k = 16,
+        backoff_max_k = 1024
+    };
+
+    static void pause(std::size_t attempt) {
+        std::uint32_t delay = attempt * backoff_per_attempt_k < backoff_max_k ?
+                                  std::uint32_t(attempt * backoff_per_attempt_k) :
+                                  std::uint32_t(backoff_max_k);
+
+        for (std::uint32_t i(0); i < delay; ++i)
+            detail::cpu_relax();
+    }
+};
+
+/******************************************************************************/
+// Wait policies. All but spin_wait_t spin until spin_count reaches the
+// predictor's spin limit, then give up the CPU on every further attempt.
+
+// Never gives up the CPU.
+struct spin_wait_t {
+    template <typename Predictor>
+    bool wait(detail::futex_word_t&, std::size_t, std::size_t, const Predictor&) {
+        return false;
+    }
+
+    template <typename Spin>
+    void release(Spin& lock) { lock.unlock(); }
+};
+
+struct yield_wait_t {
+    template <typename Predictor>
+    bool wait(detail::futex_word_t&, std::size_t spin_count, std::size_t spin_limit, const Predictor&) {
+        if (spin_count < spin_limit)
+            return false;
+
+        std::this_thread::yield();
+
+        return true;
+    }
+
+    template <typename Spin>
+    void release(Spin& lock) { lock.unlock(); }
+};
+
+// Sleeps for the predictor's sleep_time().
+struct sleep_wait_t {
+    template <typename Predictor>
+    bool wait(detail::futex_word_t&, std::size_t spin_count, std::size_t spin_limit, const Predictor& predictor) {
+        if (spin_count < spin_limit)
+            return false;
+
+        detail::parked_scope_t parked;
+
+        std::this_thread::sleep_for(predictor.sleep_time());
+
+        return true;
     }
+
+    template <typename Spin>
+    void release(Spin& lock) { lock.unlock(); }
 };
 
+// Parks on the lock word until a release wakes one waiter. A waiter marks the
+// word with waiters_k before it parks, and release() learns from its own
+// exchange whether to wake anyone, so the mutex may be destroyed as soon as
+// the word is released. Both marks and releases are RMWs on the word, so
+// either the release sees the mark or the waiter sees the released word.
+//
+// A release clears the mark even if more waiters are parked, so a woken
+// waiter puts it back before it competes for the lock again; at worst that
+// costs one spurious wake on the next release.
+struct futex_wait_t {
+    template <typename Predictor>
+    bool wait(detail::futex_word_t& word, std::size_t spin_count, std::size_t spin_limit, const Predictor&) {
+        typedef detail::lock_word_t lock_word_t;
+
+        if (spin_count < spin_limit) {
+            detail::cpu_relax();
+
+            return false;
+        }
+
+        std::uint32_t value = word.fetch_or(lock_word_t::waiters_k, std::memory_order_relaxed) |
+                              lock_word_t::waiters_k;
+
+        if (!(value & lock_word_t::locked_k))
+            return false; // released meanwhile; the mark stays for whoever takes it
+
+        detail::futex_wait(word, value);
+
+        word.fetch_or(lock_word_t::waiters_k, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    template <typename Spin>
+    void release(Spin& lock) {
+        if (lock.unlock_contended())
+            detail::futex_wake(lock.word(), 1);
+    }
+};
+
+/******************************************************************************/
+// Predictor policies.
+
+// A fixed budget: spin_limit_k attempts, then 1us sleeps.
+struct no_predictor_t {
+    enum : std::size_t { spin_limit_k = 64 };
+
+    std::size_t spin_limit() const { return spin_limit_k; }
+
+    tp_t::duration sleep_time() const { return std::chrono::microseconds(1); }
+
+    void acquired(std::size_t, bool) { }
+    void releasing() { }
+};
+
+// Twice the moving average of past spin counts, p += (m - p) / 2^Shift, shared
+// by every thread using the mutex.
+template <std::size_t Shift = 3>
+class ema_predictor_t {
+    std::atomic<std::size_t> _spin_pred{0};
+
+public:
+    std::size_t spin_limit() const { return _spin_pred.load(std::memory_order_relaxed) * 2; }
+
+    tp_t::duration sleep_time() const { return std::chrono::microseconds(1); }
+
+    // Only the holder writes, so no RMW is needed.
+    void acquired(std::size_t spin_count, bool) {
+        _spin_pred.store(detail::ema_update(_spin_pred.load(std::memory_order_relaxed), spin_count, Shift),
+                         std::memory_order_relaxed);
+    }
+
+    void releasing() { }
+};
+
+// Budgets spinning in time rather than attempts, so the budget means the same
+// on every CPU and clock speed. Predicts how long a contended wait lasts,
+// p += (m - p) / 2^Shift over waits timed with clock_t, and spins for twice
+// that, but never longer than detail::sleep_cost(): past that, sleeping would
+// have been cheaper. A wait that ended in a sleep counts as the cap. The
+// budget becomes an attempt count through a moving average of what an
+// attempt has cost in waits that spun to the end.
+//
+// Uncontended acquisitions leave the predictor alone. After a contended one
+// the holder updates it with plain stores to the mutex's own line, which it
+// already owns, so no acquisition pays for an extra RMW. Where several
+// threads can finish a wait at once, as readers of a shared mutex do, their
+// stores race, and the losers' samples are simply dropped from the average.
+template <std::size_t Shift = 3>
+class spin_time_predictor_t {
+    static constexpr double attempt_ns_initial_k = 32; // until a spin is timed
+
+    // A coarse counter times short waits as 0 ns; without a floor the attempt
+    // cost decays to 0 and the budget to an unbounded (or NaN) attempt count.
+    static constexpr double attempt_ns_min_k = 1;
+
+    std::atomic<double> _wait_ns{0};
+    std::atomic<double> _attempt_ns{attempt_ns_initial_k};
+
+    // basic_mutex reads spin_limit() once per contended lock(), at the first
+    // failed attempt, so that is when the wait started. A thread waits on one
+    // mutex at a time.
+    static tp_t& wait_start() {
+        thread_local tp_t wait_start_s;
+
+        return wait_start_s;
+    }
+
+    static double ema(double p, double m) { return p + (m - p) / double(std::size_t(1) << Shift); }
+
+    static double attempt_floor(double ns) { return ns >= attempt_ns_min_k ? ns : attempt_ns_min_k; }
+
+public:
+    std::size_t spin_limit() const {
+        double sleep_ns = std::chrono::duration<double, std::nano>(detail::sleep_cost()).count();
+        double budget_ns = (std::min)(_wait_ns.load(std::memory_order_relaxed) * 2, sleep_ns);
+        double limit = budget_ns / attempt_floor(_attempt_ns.load(std::memory_order_relaxed));
+
+        wait_start() = clock_t::now();
+
+        // A clock that steps backwards can leave the budget negative.
+        if (!(limit >= 0))
+            return 0;
+
+        return std::size_t((std::min)(limit, sleep_ns / attempt_floor(0)));
+    }
+
+    tp_t::duration sleep_time() const { return std::chrono::microseconds(1); }
+
+    void acquired(std::size_t spin_count, bool did_block) {
+        if (!spin_count)
+            return;
+
+        double wait_ns;
+
+        if (did_block) {
+            wait_ns = std::chrono::duration<double, std::nano>(detail::sleep_cost()).count();
+        } else {
+            wait_ns = std::chrono::duration<double, std::nano>(clock_t::now() - wait_start()).count();
+
+            _attempt_ns.store(attempt_floor(ema(_attempt_ns.load(std::memory_order_relaxed), wait_ns / spin_count)),
+                              std::memory_order_relaxed);
+        }
+
+        _wait_ns.store(ema(_wait_ns.load(std::memory_order_relaxed), wait_ns), std::memory_order_relaxed);
+    }
+
+    void releasing() { }
+};
+
+// As ema_predictor_t, but each thread keeps its own average, so the predictor
+// never writes to memory other threads read. Averages live in a small
+// thread-local table keyed by mutex address; a mutex that collides with
+// another in the table starts over from zero.
+template <std::size_t Shift = 3>
+class thread_predictor_t {
+    enum : std::size_t { slot_count_k = 16 };
+
+    struct slot_t {
+        const void* _owner;
+        std::size_t _spin_pred;
+    };
+
+    slot_t& slot() const {
+        thread_local slot_t slots_s[slot_count_k]{};
+
+        slot_t& slot = slots_s[reinterpret_cast<std::uintptr_t>(this) / sizeof(void*) % slot_count_k];
+
+        if (slot._owner != this) {
+            slot._owner = this;
+            slot._spin_pred = 0;
+        }
+
+        return slot;
+    }
+
+public:
+    std::size_t spin_limit() const { return slot()._spin_pred * 2; }
+
+    tp_t::duration sleep_time() const { return std::chrono::microseconds(1); }
+
+    void acquired(std::size_t spin_count, bool) {
+        slot_t& s = slot();
+
+        s._spin_pred = detail::ema_update(s._spin_pred, spin_count, Shift);
+    }
+
+    void releasing() { }
+};
+
+// Predicts how long the lock will stay held, p += (m - p) / 2^Shift over the
+// hold times of one acquisition in SampleRate, so most acquisitions never read
+// the clock. Waiters spin for up to short_spin_k attempts while the predicted
+// hold is shorter than parking would take, and otherwise give up the CPU at
+// once; sleep_wait_t sleeps for the predicted hold.
+template <std::size_t Shift = 3, std::size_t SampleRate = 16>
+class hold_predictor_t {
+    enum : std::size_t {
+        short_hold_ns_k = 2000,
+        short_spin_k = 128
+    };
+
+    std::atomic<diff_t> _hold_pred{0};
+    std::size_t         _sample_count{0}; // holder only
+    tp_t                _hold_start;      // holder only, when sampled
+    bool                _sampled{false};  // holder only
+
+public:
+    std::size_t spin_limit() const {
+        return sleep_time() < std::chrono::nanoseconds(short_hold_ns_k) ? std::size_t(short_spin_k) : 0;
+    }
+
+    tp_t::duration sleep_time() const { return tp_t::duration(_hold_pred.load(std::memory_order_relaxed)); }
+
+    void acquired(std::size_t, bool) {
+        _sampled = ++_sample_count % SampleRate == 0;
+
+        if (_sampled)
+            _hold_start = clock_t::now();
+    }
+
+    // try_lock() does not report to the predictor, so a sample must not
+    // outlive the acquisition that took it.
+    void releasing() {
+        if (!_sampled)
+            return;
+
+        _sampled = false;
+
+        diff_t pred = _hold_pred.load(std::memory_order_relaxed);
+
+        _hold_pred.store(pred + ((clock_t::now() - _hold_start).count() - pred) / (diff_t(1) << Shift),
+                         std::memory_order_relaxed);
+    }
+};
+
+/******************************************************************************/
+
+} // namespace policy
+
+/******************************************************************************/
+// A mutex assembled from the policies above; see there for what each one
+// does. spin_mutex_t, adaptive_spin_mutex_t and adaptive_block_mutex_t are
+// particular combinations. Wait and Predictor are private bases so that empty
+// policies take no space.
+
+template <typename Spin,
+          typename Backoff,
+          typename Wait,
+          typename Predictor,
+          typename Probe = null_probe_t>
+class basic_mutex : public Probe, private Wait, private Predictor {
+private:
+    Spin _lock;
+
+public:
+    typedef Probe probe_type;
+
+    template <typename P>
+    using rebind_probe = basic_mutex<Spin, Backoff, Wait, Predictor, P>;
+
+    bool try_lock() {
+        return _lock.try_lock();
+    }
+
+    void lock() {
+        typename Probe::wait_t probe_wait(*this);
+        bool                   did_block{false};
+        std::size_t            spin_count{0};
+        std::size_t            spin_limit{0};
+
+        while (!_lock.try_lock()) {
+            probe_wait.start();
+
+            // Read the prediction only once we know we will need it.
+            if (++spin_count == 1)
+                spin_limit = Predictor::spin_limit();
+
+            Backoff::pause(spin_count);
+
+            if (Wait::wait(_lock.word(), spin_count, spin_limit, static_cast<const Predictor&>(*this)))
+                did_block = true;
+        }
+
+        Predictor::acquired(spin_count, did_block);
+
+        this->on_acquired(spin_count, did_block, probe_wait);
+    }
+
+    void unlock() {
+        this->on_releasing();
+
+        Predictor::releasing();
+
+        Wait::release(_lock);
+    }
+};
+
+/******************************************************************************/
+
+template <typename Probe = null_probe_t>
+using basic_spin_mutex = basic_mutex<policy::tas_t,
+                                     policy::no_backoff_t,
+                                     policy::spin_wait_t,
+                                     policy::no_predictor_t,
+                                     Probe>;
+
+using spin_mutex_t = basic_spin_mutex<null_probe_t>;
+
+/******************************************************************************/
+// Test-and-test-and-set: waiters spin on a plain load, which keeps the line
+// shared among them, and only attempt the exclusive RMW once the lock looks
+// free. Each failed RMW backs off for a randomized, exponentially growing
+// number of pause instructions so waiters don't all stampede on release.
+
+template <typename Probe = null_probe_t>
+class basic_ttas_spin_mutex : public Probe {
+private:
+    enum : std::uint32_t {
+        backoff_min_k = 4,
+        backoff_max_k = 1024
+    };
+
+    std::atomic<bool> _lock{false};
+
+public:
+    typedef Probe probe_type;
+
+    template <typename P>
+    using rebind_probe = basic_ttas_spin_mutex<P>;
+
+    bool try_lock() {
+        return !_lock.load(std::memory_order_relaxed) &&
+               !_lock.exchange(true, std::memory_order_acquire);
+    }
+
+    void lock() {
+        typename Probe::wait_t wait(*this);
+        std::size_t            spin_count{0};
+        std::uint32_t          backoff{backoff_min_k};
+
+        while (_lock.exchange(true, std::memory_order_acquire)) {
+            wait.start();
+
+            // Lost the race; wait somewhere in [backoff/2, backoff) pauses.
+            std::uint32_t delay{backoff / 2 + detail::jitter() % (backoff / 2)};
+
+            for (std::uint32_t i(0); i < delay; ++i)
+                detail::cpu_relax();
+
+            backoff = (std::min)(backoff * 2, std::uint32_t(backoff_max_k));
+
+            while (_lock.load(std::memory_order_relaxed)) {
+                detail::cpu_relax();
+                ++spin_count;
+            }
+        }
+
+        this->on_acquired(spin_count, false, wait);
+    }
+
+    void unlock() {
+        this->on_releasing();
+
+        _lock.store(false, std::memory_order_release);
+    }
+};
+
+using ttas_spin_mutex_t = basic_ttas_spin_mutex<null_probe_t>;
+
+/******************************************************************************/
+
+// Spins for twice the average contended wait, up to what a sleep costs on this
+// machine, then sleeps in 1us steps.
+template <typename Probe = null_probe_t>
+using basic_adaptive_spin_mutex = basic_mutex<policy::tas_t,
+                                              policy::no_backoff_t,
+                                              policy::sleep_wait_t,
+                                              policy::spin_time_predictor_t<3>,
+                                              Probe>;
+
+using adaptive_spin_mutex_t = basic_adaptive_spin_mutex<null_probe_t>;
+
+/******************************************************************************/
+// Blocking mutex: waiters park on the lock word and each release wakes one.
+// A waiter only spins first, briefly, when the sampled hold-time prediction
+// says the lock will come free sooner than a park and wake would take.
+
+template <typename Probe = null_probe_t>
+using basic_adaptive_block_mutex = basic_mutex<policy::tas_t,
+                                               policy::no_backoff_t,
+                                               policy::futex_wait_t,
+                                               policy::hold_predictor_t<3, 16>,
+                                               Probe>;
+
+using adaptive_block_mutex_t = basic_adaptive_block_mutex<null_probe_t>;
+
+/******************************************************************************/
+
+template <typename Probe = null_probe_t>
+class basic_adaptive_futex_mutex : public Probe {
+private:
+    enum : std::uint32_t {
+        unlocked_k,
+        locked_k,
+        contended_k // locked, and at least one thread may be parked
+    };
+
+    // Floor on the spin budget. Acquisitions that end up parking do not feed
+    // the predictor, so without a floor a prediction of zero would never grow.
+    enum : std::size_t { spin_floor_k = 64 };
+
+    detail::futex_word_t     _state{unlocked_k};
+    std::atomic<std::size_t> _spin_pred{0};
+
+public:
+    typedef Probe probe_type;
+
+    template <typename P>
+    using rebind_probe = basic_adaptive_futex_mutex<P>;
+
+    bool try_lock() {
+        std::uint32_t expected{unlocked_k};
+
+        return _state.compare_exchange_strong(expected,
+                                              locked_k,
+                                              std::memory_order_acquire,
+                                              std::memory_order_relaxed);
+    }
+
+    void lock() {
+        typename Probe::wait_t wait(*this);
+        bool                   did_block{false};
+        std::size_t            spin_count{0};
+        std::size_t            spin_max{(std::max)(_spin_pred.load(std::memory_order_relaxed) * 2,
+                                                   std::size_t(spin_floor_k))};
+
+        while (!try_lock()) {
+            wait.start();
+
+            if (++spin_count < spin_max)
+                continue;
+
+            // Spin budget exhausted. Mark the lock contended so the holder
+            // knows to wake us, then park until the lock word changes. If the
+            // exchange observes unlocked_k we own the lock (as contended_k,
+            // which costs at most one spurious wake on unlock).
+            while (_state.exchange(contended_k, std::memory_order_acquire) != unlocked_k)
+                detail::futex_wait(_state, contended_k);
+
+            did_block = true;
+
+            break;
+        }
+
+        if (!did_block)
+            _spin_pred.store(detail::ema_update(_spin_pred.load(std::memory_order_relaxed), spin_count),
+                             std::memory_order_relaxed);
+
+        this->on_acquired(spin_count, did_block, wait);
+    }
+
+    void unlock() {
+        this->on_releasing();
+
+        // Only pay for the syscall when someone may actually be parked.
+        if (_state.exchange(unlocked_k, std::memory_order_release) == contended_k)
+            detail::futex_wake(_state, 1);
+    }
+};
+
+using adaptive_futex_mutex_t = basic_adaptive_futex_mutex<null_probe_t>;
+
+/******************************************************************************/
+// Adaptive futex mutex whose waiters spin only while the holder looks to be
+// making progress, in the spirit of the kernel's owner-spinning mutexes. The
+// holder publishes its thread_record_t in _owner. A waiter parks at once if
+// the holder is itself parked or sleeping in a mutexpp wait; otherwise it
+// spins until the same holder has kept the lock for spin_cutoff_k. User space
+// cannot see that a holder was preempted, so the cutoff stands in for that:
+// it bounds the spinning wasted on a descheduled holder to a small fraction
+// of a time slice, while a handoff to a new holder restarts the clock.
+
+template <typename Probe = null_probe_t>
+class basic_owner_aware_mutex : public Probe {
+private:
+    enum : std::uint32_t {
+        unlocked_k,
+        locked_k,
+        contended_k // locked, and at least one thread may be parked
+    };
+
+    enum : std::size_t {
+        spin_cutoff_k = 20000, // ns of spinning on one running holder
+        clock_interval_k = 64  // spins between clock reads
+    };
+
+    detail::futex_word_t                  _state{unlocked_k};
+    std::atomic<detail::thread_record_t*> _owner{nullptr}; // release, so waiters see a built record
+
+    void park() {
+        while (_state.exchange(contended_k, std::memory_order_acquire) != unlocked_k)
+            detail::futex_wait(_state, contended_k);
+    }
+
+public:
+    typedef Probe probe_type;
+
+    template <typename P>
+    using rebind_probe = basic_owner_aware_mutex<P>;
+
+    bool try_lock() {
+        std::uint32_t expected{unlocked_k};
+
+        if (!_state.compare_exchange_strong(expected,
+                                            locked_k,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed))
+            return false;
+
+        _owner.store(&detail::this_thread_record(), std::memory_order_release);
+
+        return true;
+    }
+
+    void lock() {
+        typename Probe::wait_t   wait(*this);
+        bool                     did_block{false};
+        std::size_t              spin_count{0};
+        detail::thread_record_t* watched{nullptr};
+        tp_t                     deadline;
+
+        while (!try_lock()) {
+            wait.start();
+
+            ++spin_count;
+
+            detail::thread_record_t* owner = _owner.load(std::memory_order_acquire);
+
+            // No owner yet means the lock is changing hands; keep spinning.
+            if (owner) {
+                if (owner != watched) {
+                    watched = owner;
+                    deadline = clock_t::now() + std::chrono::nanoseconds(spin_cutoff_k);
+                }
+
+                bool expired = spin_count % clock_interval_k == 0 && clock_t::now() >= deadline;
+
+                if (owner->_parked.load(std::memory_order_relaxed) || expired) {
+                    park();
+
+                    _owner.store(&detail::this_thread_record(), std::memory_order_release);
+
+                    did_block = true;
+
+                    break;
+                }
+            }
+
+            detail::cpu_relax();
+        }
+
+        this->on_acquired(spin_count, did_block, wait);
+    }
+
+    void unlock() {
+        this->on_releasing();
+
+        _owner.store(nullptr, std::memory_order_relaxed);
+
+        // Only pay for the syscall when someone may actually be parked.
+        if (_state.exchange(unlocked_k, std::memory_order_release) == contended_k)
+            detail::futex_wake(_state, 1);
+    }
+};
+
+using owner_aware_mutex_t = basic_owner_aware_mutex<null_probe_t>;
+
+/******************************************************************************/
+// Mellor-Crummey & Scott queue lock. Waiters enqueue a node with one exchange on
+// the tail, then spin only on their own node until the predecessor hands the
+// lock over, giving FIFO handoff and O(1) cache-line transfers per acquisition.
+// Nodes come from a thread-local pool so the class is a plain Lockable, usable
+// with std::lock_guard; as with std::mutex, unlock() must be called from the
+// thread that locked. Strict FIFO handoff to a preempted waiter stalls the
+// whole queue, so waiters periodically yield to limit the damage when the
+// machine is oversubscribed.
+
+template <typename Probe = null_probe_t>
+class alignas(detail::cache_line_k) basic_mcs_mutex : public Probe {
+private:
+    enum : std::size_t { yield_interval_k = 1024 };
+
+    std::atomic<detail::mcs_node_t*> _tail{nullptr};
+    detail::mcs_node_t*              _owner{nullptr}; // only touched by the holder
+
+public:
+    typedef Probe probe_type;
+
+    template <typename P>
+    using rebind_probe = basic_mcs_mutex<P>;
+
+    bool try_lock() {
+        auto&               pool = detail::mcs_node_pool();
+        detail::mcs_node_t* node = pool.acquire();
+        detail::mcs_node_t* expected{nullptr};
+
+        if (!_tail.compare_exchange_strong(expected,
+                                           node,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed)) {
+            pool.release(node);
+
+            return false;
+        }
+
+        _owner = node;
+
+        return true;
+    }
+
+    void lock() {
+        typename Probe::wait_t wait(*this);
+        std::size_t            spin_count{0};
+        detail::mcs_node_t*    node = detail::mcs_node_pool().acquire();
+        detail::mcs_node_t*    pred = _tail.exchange(node, std::memory_order_acq_rel);
+
+        if (pred) {
+            wait.start();
+
+            pred->_next.store(node, std::memory_order_release);
+
+            while (node->_locked.load(std::memory_order_acquire)) {
+                // Handoff is strictly FIFO, so if our predecessor has been
+                // preempted nothing but giving up the CPU will help.
+                if (++spin_count % yield_interval_k)
+                    detail::cpu_relax();
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+        _owner = node;
+
+        this->on_acquired(spin_count, false, wait);
+    }
+
+    void unlock() {
+        this->on_releasing();
+
+        detail::mcs_node_t* node = _owner;
+        detail::mcs_node_t* next = node->_next.load(std::memory_order_acquire);
+
+        if (!next) {
+            detail::mcs_node_t* expected{node};
+
+            if (_tail.compare_exchange_strong(expected,
+                                              nullptr,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+                detail::mcs_node_pool().release(node);
+
+                return;
+            }
+
+            // A successor swapped itself onto the tail but has not linked
+            // itself to us yet; wait for it to do so.
+            for (std::size_t spin(1); !(next = node->_next.load(std::memory_order_acquire)); ++spin) {
+                if (spin % yield_interval_k)
+                    detail::cpu_relax();
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+        next->_locked.store(false, std::memory_order_release);
+
+        detail::mcs_node_pool().release(node);
+    }
+};
+
+using mcs_mutex_t = basic_mcs_mutex<null_probe_t>;
+
+/******************************************************************************/
+// Ticket lock. Acquisition order is FIFO by ticket, so no thread can be starved
+// by others reacquiring the lock. The two counters live on separate cache
+// lines: arriving threads only touch _next, and waiters only read _serving.
+// Waiters back off in proportion to the number of tickets ahead of them, so
+// only the thread next in line polls the release line aggressively.
+
+template <typename Probe = null_probe_t>
+class basic_ticket_mutex : public Probe {
+private:
+    enum : std::uint32_t {
+        backoff_per_ticket_k = 32, // pauses per waiter ahead of us
+        yield_interval_k = 64      // backoff rounds between yields
+    };
+
+    alignas(detail::cache_line_k) std::atomic<std::uint32_t> _next{0};
+    alignas(detail::cache_line_k) std::atomic<std::uint32_t> _serving{0};
+
+public:
+    typedef Probe probe_type;
+
+    template <typename P>
+    using rebind_probe = basic_ticket_mutex<P>;
+
+    bool try_lock() {
+        std::uint32_t serving = _serving.load(std::memory_order_acquire);
+        std::uint32_t expected{serving};
+
+        return _next.compare_exchange_strong(expected,
+                                             serving + 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed);
+    }
+
+    void lock() {
+        typename Probe::wait_t wait(*this);
+        std::size_t            spin_count{0};
+        std::uint32_t          ticket = _next.fetch_add(1, std::memory_order_relaxed);
+
+        while (true) {
+            std::uint32_t serving = _serving.load(std::memory_order_acquire);
+
+            if (serving == ticket)
+                break;
+
+            wait.start();
+
+            // Unsigned subtraction keeps the distance right across wraparound.
+            std::uint32_t delay = (ticket - serving) * backoff_per_ticket_k;
+
+            for (std::uint32_t i(0); i < delay; ++i)
+                detail::cpu_relax();
+
+            // As with mcs_mutex_t, a preempted thread ahead of us stalls the
+            // queue; give it a chance to run.
+            if (++spin_count % yield_interval_k == 0)
+                std::this_thread::yield();
+        }
+
+        this->on_acquired(spin_count, false, wait);
+    }
+
+    void unlock() {
+        this->on_releasing();
+
+        // Only the holder writes _serving, so a plain increment suffices.
+        _serving.store(_serving.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_release);
+    }
+};
+
+using ticket_mutex_t = basic_ticket_mutex<null_probe_t>;
+
+/******************************************************************************/
+
+namespace detail {
+
+/******************************************************************************/
+// Reader indicators for basic_shared_mutex. Each thread is assigned one of a
+// fixed number of cache-line-padded counters, so concurrent readers on
+// different threads usually increment different lines instead of contending
+// on one shared count. Writers pay for it by scanning every slot.
+//
+// A count is a futex word, so a writer can park on it while it drains. The
+// writer marks it with writer_waiting_k first, and the reader whose decrement
+// leaves just the mark behind wakes it; that decrement is the last time the
+// reader touches the mutex.
+
+enum : std::size_t { reader_slot_count_k = 16 };
+
+struct alignas(cache_line_k) reader_slot_t {
+    enum : std::uint32_t { writer_waiting_k = 1u << 31 };
+
+    futex_word_t _count{0};
+};
+
+inline std::size_t reader_slot_index() {
+    static std::atomic<std::size_t> next_s{0};
+    thread_local std::size_t        index_s{next_s.fetch_add(1, std::memory_order_relaxed) %
+                                            reader_slot_count_k};
+
+    return index_s;
+}
+
+/******************************************************************************/
+// Wait strategies for basic_shared_mutex, named reader_*_wait_t to keep them
+// apart from the Wait policies of basic_mutex, whose contract differs. They
+// serve both sides of the mutex: readers waiting for the gate, and a writer
+// waiting for the readers to drain. wait() returns once done() holds;
+// notify() must be called after any change to word that could make done()
+// true for a thread waiting on it, while the mutex is still in use. Loading
+// word before testing done() means a change that lands after the test also
+// changes the value we would park on.
+//
+// drain() returns once a reader slot's count is zero. A reader leaving the
+// slot calls the static drained() when its decrement left writer_waiting_k
+// alone in the count; being static, it touches nothing but the word.
+
+struct reader_spin_wait_t {
+    template <typename F>
+    void wait(futex_word_t&, F done) {
+        while (!done())
+            cpu_relax();
+    }
+
+    void notify(futex_word_t&, int) { }
+
+    void drain(futex_word_t& count) {
+        while (count.load(std::memory_order_seq_cst))
+            cpu_relax();
+    }
+
+    static void drained(futex_word_t&) { }
+};
+
+// Same spin-then-sleep shape and time-budgeted prediction as
+// adaptive_spin_mutex_t. spin_limit() is read once, at the first failed test,
+// which is when spin_time_predictor_t dates the start of the wait.
+class reader_adaptive_spin_wait_t {
+    policy::spin_time_predictor_t<3> _predictor;
+
+public:
+    template <typename F>
+    void wait(futex_word_t&, F done) {
+        bool        did_block{false};
+        std::size_t spin_count{0};
+        std::size_t spin_max{0};
+
+        while (!done()) {
+            if (!spin_count)
+                spin_max = _predictor.spin_limit();
+
+            ++spin_count;
+
+            if (spin_count < spin_max)
+                continue;
+
+            parked_scope_t parked;
+
+            std::this_thread::sleep_for(_predictor.sleep_time());
+
+            did_block = true;
+        }
+
+        _predictor.acquired(spin_count, did_block);
+    }
+
+    void notify(futex_word_t&, int) { }
+
+    void drain(futex_word_t& count) {
+        wait(count, [&count](){ return !count.load(std::memory_order_seq_cst); });
+    }
+
+    static void drained(futex_word_t&) { }
+};
+
+// Same spin phase as adaptive_futex_mutex_t, then parks on the word. _parked
+// lets notify() skip the syscall when nobody is asleep.
+class reader_futex_wait_t {
+    enum : std::size_t { spin_floor_k = 64 };
+
+    std::atomic<std::size_t>   _spin_pred{0};
+    std::atomic<std::uint32_t> _parked{0};
+
+public:
+    template <typename F>
+    void wait(futex_word_t& word, F done) {
+        bool        did_block{false};
+        std::size_t spin_count{0};
+        std::size_t spin_max{(std::max)(_spin_pred.load(std::memory_order_relaxed) * 2,
+                                        std::size_t(spin_floor_k))};
+
+        while (true) {
+            std::uint32_t value = word.load(std::memory_order_seq_cst);
+
+            if (done())
+                break;
+
+            if (++spin_count < spin_max) {
+                cpu_relax();
+                continue;
+            }
+
+            _parked.fetch_add(1, std::memory_order_seq_cst);
+            futex_wait(word, value);
+            _parked.fetch_sub(1, std::memory_order_relaxed);
+
+            did_block = true;
+        }
+
+        if (!did_block)
+            _spin_pred.store(ema_update(_spin_pred.load(std::memory_order_relaxed), spin_count),
+                             std::memory_order_relaxed);
+    }
+
+    void notify(futex_word_t& word, int count) {
+        if (_parked.load(std::memory_order_seq_cst))
+            futex_wake(word, count);
+    }
+
+    // Only one writer drains at a time, so the mark is ours to clear.
+    void drain(futex_word_t& count) {
+        bool        did_block{false};
+        std::size_t spin_count{0};
+        std::size_t spin_max{(std::max)(_spin_pred.load(std::memory_order_relaxed) * 2,
+                                        std::size_t(spin_floor_k))};
+
+        while (count.load(std::memory_order_seq_cst) & ~std::uint32_t(reader_slot_t::writer_waiting_k)) {
+            if (++spin_count < spin_max) {
+                cpu_relax();
+                continue;
+            }
+
+            std::uint32_t value = count.fetch_or(reader_slot_t::writer_waiting_k, std::memory_order_seq_cst) |
+                                  reader_slot_t::writer_waiting_k;
+
+            if (value == reader_slot_t::writer_waiting_k)
+                break;
+
+            futex_wait(count, value);
+
+            did_block = true;
+        }
+
+        count.fetch_and(~std::uint32_t(reader_slot_t::writer_waiting_k), std::memory_order_relaxed);
+
+        if (!did_block)
+            _spin_pred.store(ema_update(_spin_pred.load(std::memory_order_relaxed), spin_count),
+                             std::memory_order_relaxed);
+    }
+
+    static void drained(futex_word_t& count) { futex_wake(count, 1); }
+};
+
+/******************************************************************************/
+
+} // namespace detail
+
+/******************************************************************************/
+// Reader-writer mutex satisfying SharedLockable. Writers serialize on an
+// exclusive WriterMutex, close the gate to new readers, and wait for the
+// per-thread reader slots to drain. Readers bump their slot and check the
+// gate; if a writer is present they back out and wait for the gate to reopen,
+// so a steady stream of readers cannot starve writers.
+//
+// The slot increment followed by the gate load (and the gate store followed by
+// the slot loads on the writer side) must be sequentially consistent: that is
+// what guarantees at least one side sees the other.
+
+template <typename WriterMutex, typename Wait, typename Probe = null_probe_t>
+class basic_shared_mutex : public Probe {
+private:
+    enum : std::uint32_t {
+        open_k,
+        closed_k
+    };
+
+    detail::reader_slot_t _readers[detail::reader_slot_count_k];
+    WriterMutex           _writer;
+    detail::futex_word_t  _gate{open_k};
+    Wait                  _reader_wait;
+    Wait                  _writer_wait;
+
+    bool drained() const {
+        for (const auto& slot : _readers)
+            if (slot._count.load(std::memory_order_seq_cst))
+                return false;
+
+        return true;
+    }
+
+    bool gate_open() const {
+        return _gate.load(std::memory_order_acquire) == open_k;
+    }
+
+    void open_gate() {
+        _gate.store(open_k, std::memory_order_seq_cst);
+        _reader_wait.notify(_gate, INT_MAX);
+    }
+
+public:
+    // Only exclusive (writer) acquisitions are probed; a wait covers both
+    // getting the writer mutex and draining the readers.
+    typedef Probe probe_type;
+
+    template <typename P>
+    using rebind_probe = basic_shared_mutex<WriterMutex, Wait, P>;
+
+    basic_shared_mutex() = default;
+    basic_shared_mutex(const basic_shared_mutex&) = delete;
+    basic_shared_mutex& operator=(const basic_shared_mutex&) = delete;
+
+    bool try_lock() {
+        if (!_writer.try_lock())
+            return false;
+
+        _gate.store(closed_k, std::memory_order_seq_cst);
+
+        if (drained())
+            return true;
+
+        open_gate();
+        _writer.unlock();
+
+        return false;
+    }
+
+    void lock() {
+        typename Probe::wait_t wait(*this);
+
+        if (!_writer.try_lock()) {
+            wait.start();
+            _writer.lock();
+        }
+
+        _gate.store(closed_k, std::memory_order_seq_cst);
+
+        if (!drained()) {
+            wait.start();
+
+            for (auto& slot : _readers)
+                _writer_wait.drain(slot._count);
+        }
+
+        this->on_acquired(0, false, wait);
+    }
+
+    void unlock() {
+        this->on_releasing();
+
+        open_gate();
+
+        _writer.unlock();
+    }
+
+    bool try_lock_shared() {
+        _readers[detail::reader_slot_index()]._count.fetch_add(1, std::memory_order_seq_cst);
+
+        if (_gate.load(std::memory_order_seq_cst) == open_k)
+            return true;
+
+        unlock_shared();
+
+        return false;
+    }
+
+    void lock_shared() {
+        while (!try_lock_shared())
+            _reader_wait.wait(_gate, [this](){ return gate_open(); });
+    }
+
+    // A writer may destroy the mutex as soon as the slot drains, so the
+    // decrement alone says whether one is parked on it.
+    void unlock_shared() {
+        detail::futex_word_t& count = _readers[detail::reader_slot_index()]._count;
+
+        if (count.fetch_sub(1, std::memory_order_seq_cst) == (detail::reader_slot_t::writer_waiting_k | 1))
+            Wait::drained(count);
+    }
+};
+
+/******************************************************************************/
+
+using shared_spin_mutex_t = basic_shared_mutex<spin_mutex_t, detail::reader_spin_wait_t>;
+using adaptive_shared_spin_mutex_t = basic_shared_mutex<adaptive_spin_mutex_t, detail::reader_adaptive_spin_wait_t>;
+using shared_futex_mutex_t = basic_shared_mutex<adaptive_futex_mutex_t, detail::reader_futex_wait_t>;
+
+/******************************************************************************/
+// std::shared_lock arrives with C++14; this covers the scoped case for C++11.
+
+template <typename SharedMutex>
+class shared_lock_guard {
+    SharedMutex& _m;
+
+public:
+    using mutex_type = SharedMutex;
+
+    explicit shared_lock_guard(SharedMutex& m) : _m(m) {
+        _m.lock_shared();
+    }
+
+    ~shared_lock_guard() {
+        _m.unlock_shared();
+    }
+
+    shared_lock_guard(const shared_lock_guard&) = delete;
+    shared_lock_guard& operator=(const shared_lock_guard&) = delete;
+};
+
+/******************************************************************************/
+// A fixed table of N mutexes, each aligned to its own cache line(s), with
+// keys hashed onto them. Guarding N shards of a container with one stripe
+// each spreads contention that would otherwise pile onto a single mutex.
+//
+// Single-key operations lock stripe_for(key) directly. Operations spanning
+// several keys should go through striped_lock_guard, which takes the stripes
+// involved in ascending index order (each at most once) so that two of them
+// can never deadlock against each other.
+
+template <typename Mutex, std::size_t N>
+class striped_mutex {
+    static_assert(N > 0, "striped_mutex needs at least one stripe");
+
+    struct alignas(detail::cache_line_k) stripe_t {
+        Mutex _mutex;
+    };
+
+    stripe_t _stripes[N];
+
+public:
+    using mutex_type = Mutex;
+    using stripe_set_t = std::bitset<N>;
+
+    enum : std::size_t { stripe_count_k = N };
+
+    striped_mutex() = default;
+
+    striped_mutex(const striped_mutex&) = delete;
+    striped_mutex& operator=(const striped_mutex&) = delete;
+
+    // std::hash is the identity for integers in some standard libraries, so
+    // the hash is run through a Fibonacci multiply before it is reduced.
+    template <typename Key, typename Hash = std::hash<Key>>
+    static std::size_t stripe_of(const Key& key, const Hash& hash = Hash()) {
+        std::uint64_t mixed = static_cast<std::uint64_t>(hash(key)) * 0x9e3779b97f4a7c15ull;
+
+        return static_cast<std::size_t>(mixed >> 32) % N;
+    }
+
+    Mutex& stripe(std::size_t index) { return _stripes[index]._mutex; }
+
+    template <typename Key>
+    Mutex& stripe_for(const Key& key) { return stripe(stripe_of(key)); }
+
+    void lock(const stripe_set_t& stripes) {
+        for (std::size_t i(0); i < N; ++i)
+            if (stripes[i])
+                stripe(i).lock();
+    }
+
+    void unlock(const stripe_set_t& stripes) {
+        for (std::size_t i(N); i-- != 0;)
+            if (stripes[i])
+                stripe(i).unlock();
+    }
+};
+
+/******************************************************************************/
+// Holds the stripes of a striped_mutex covering a set of keys.
+
+template <typename StripedMutex>
+class striped_lock_guard {
+    using stripe_set_t = typename StripedMutex::stripe_set_t;
+
+    StripedMutex& _m;
+    stripe_set_t  _stripes;
+
+public:
+    template <typename Iterator>
+    striped_lock_guard(StripedMutex& m, Iterator first, Iterator last) : _m(m) {
+        for (; first != last; ++first)
+            _stripes.set(StripedMutex::stripe_of(*first));
+
+        _m.lock(_stripes);
+    }
+
+    template <typename Key>
+    striped_lock_guard(StripedMutex& m, std::initializer_list<Key> keys) :
+        striped_lock_guard(m, keys.begin(), keys.end()) {
+    }
+
+    ~striped_lock_guard() {
+        _m.unlock(_stripes);
+    }
+
+    striped_lock_guard(const striped_lock_guard&) = delete;
+    striped_lock_guard& operator=(const striped_lock_guard&) = delete;
+};
+
+/******************************************************************************/
+// Sequence lock: readers never write to shared memory, and writers are
+// serialized by Mutex. The sequence is odd while a write is in progress and
+// moves on with every write, so a reader that saw the same even value before
+// and after its reads knows they were not torn:
+//
+//     std::uint32_t seq;
+//     do {
+//         seq = lock.read_begin();
+//         // relaxed atomic loads of the guarded data
+//     } while (lock.read_retry(seq));
+//
+// Writers hold the seqlock like any mutex, and store the guarded data with
+// relaxed atomic stores while they do. The orderings follow Boehm, "Can
+// seqlocks get along with programming language memory models?" (2012).
+
+template <typename Mutex>
+class basic_seqlock {
+    enum : std::size_t { spin_limit_k = 64 };
+
+    std::atomic<std::uint32_t> _seq{0};
+    Mutex                      _mutex;
+
+public:
+    using mutex_type = Mutex;
+
+    // Waits out any write in progress. Past spin_limit_k attempts the writer
+    // has probably been descheduled, so the reader yields to let it finish.
+    std::uint32_t read_begin() const {
+        std::uint32_t seq;
+
+        for (std::size_t spin_count(0); (seq = _seq.load(std::memory_order_acquire)) & 1; ++spin_count) {
+            if (spin_count < spin_limit_k)
+                detail::cpu_relax();
+            else
+                std::this_thread::yield();
+        }
+
+        return seq;
+    }
+
+    bool read_retry(std::uint32_t seq) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        return _seq.load(std::memory_order_relaxed) != seq;
+    }
+
+    bool try_lock() {
+        if (!_mutex.try_lock())
+            return false;
+
+        begin_write();
+
+        return true;
+    }
+
+    void lock() {
+        _mutex.lock();
+
+        begin_write();
+    }
+
+    void unlock() {
+        _seq.store(_seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+        _mutex.unlock();
+    }
+
+private:
+    // Only the writer changes the sequence, so no RMW is needed.
+    void begin_write() {
+        _seq.store(_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+};
+
+using seqlock_t = basic_seqlock<adaptive_futex_mutex_t>;
+
+/******************************************************************************/
+// A trivially copyable T behind a seqlock. load() is lock-free and never
+// writes to shared memory, so readers scale with the core count however hot
+// the value is; it retries while writers are active, so it suits data read
+// far more often than written. Writers take Mutex.
+//
+// The value is kept as an array of atomic words, copied with relaxed loads and
+// stores, so that a read racing a write is a retry rather than a data race.
+// Copies out of the words go through raw storage, so T need not be default
+// constructible; only the default constructor asks for that.
+
+template <typename T, typename Mutex = adaptive_futex_mutex_t>
+class versioned {
+    static_assert(std::is_trivially_copyable<T>::value, "versioned<T> needs a trivially copyable T");
+
+    using word_t = std::uintptr_t;
+    using storage_t = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    enum : std::size_t { word_count_k = (sizeof(T) + sizeof(word_t) - 1) / sizeof(word_t) };
+
+    mutable basic_seqlock<Mutex> _lock;
+    std::atomic<word_t>          _words[word_count_k];
+
+    void read_words(word_t* words) const {
+        for (std::size_t i(0); i < word_count_k; ++i)
+            words[i] = _words[i].load(std::memory_order_relaxed);
+    }
+
+    void write(const T& value) {
+        word_t words[word_count_k]{};
+
+        std::memcpy(words, &value, sizeof(T));
+
+        for (std::size_t i(0); i < word_count_k; ++i)
+            _words[i].store(words[i], std::memory_order_relaxed);
+    }
+
+public:
+    using value_type = T;
+    using mutex_type = Mutex;
+
+    template <typename U = T,
+              typename = typename std::enable_if<std::is_default_constructible<U>::value>::type>
+    versioned() : versioned(T()) { }
+
+    explicit versioned(const T& value) { write(value); }
+
+    versioned(const versioned&) = delete;
+    versioned& operator=(const versioned&) = delete;
+
+    T load() const {
+        word_t        words[word_count_k];
+        std::uint32_t seq;
+
+        do {
+            seq = _lock.read_begin();
+
+            read_words(words);
+        } while (_lock.read_retry(seq));
+
+        storage_t result;
+
+        std::memcpy(&result, words, sizeof(T));
+
+        return *reinterpret_cast<const T*>(&result);
+    }
+
+    void store(const T& value) {
+        std::lock_guard<basic_seqlock<Mutex>> lock(_lock);
+
+        write(value);
+    }
+
+    // Read-modify-write under the writer lock: f gets a copy of the current
+    // value to change, which is then stored in its place.
+    template <typename F>
+    void update(F f) {
+        std::lock_guard<basic_seqlock<Mutex>> lock(_lock);
+        word_t                                words[word_count_k];
+        storage_t                             storage;
+
+        read_words(words);
+
+        std::memcpy(&storage, words, sizeof(T));
+
+        T& value = *reinterpret_cast<T*>(&storage);
+
+        f(value);
+
+        write(value);
+    }
+};
+
+/******************************************************************************/
+
+#if MUTEXPP_HAS_COROUTINES
+
+/******************************************************************************/
+
+namespace detail {
+
+/******************************************************************************/
+// Awaiter behind serial_queue_t::schedule(): suspends the coroutine and
+// resumes it as a task on the queue. The handle fits in a task slot, so on
+// the portable backend this does not allocate.
+
+template <typename Queue>
+struct schedule_awaiter_t {
+    Queue& _queue;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        _queue.execute([handle](){ handle.resume(); });
+    }
+
+    void await_resume() const noexcept { }
+};
+
+/******************************************************************************/
+
+} // namespace detail
+
+/******************************************************************************/
+// Mutex for coroutines: co_await m.async_lock() suspends the caller while the
+// lock is held rather than spinning or blocking the thread. Waiters queue in
+// FIFO order and unlock() hands ownership straight to the oldest one,
+// resuming it on the unlocking thread. The Mutex parameter only guards the
+// waiter list, for a handful of instructions at a time.
+//
+// To release with RAII after the co_await, adopt the lock:
+//     std::unique_lock<async_mutex_t> lock(m, std::adopt_lock);
+
+template <typename Mutex>
+class basic_async_mutex {
+    typedef std::lock_guard<Mutex> guard_t;
+
+    struct waiter_t {
+        std::coroutine_handle<> _handle;
+        waiter_t*               _next{nullptr};
+    };
+
+    Mutex     _mutex;
+    bool      _locked{false};
+    waiter_t* _head{nullptr};
+    waiter_t* _tail{nullptr};
+
+public:
+    class lock_awaiter_t {
+        basic_async_mutex& _m;
+        waiter_t           _waiter;
+
+    public:
+        explicit lock_awaiter_t(basic_async_mutex& m) : _m(m) { }
+
+        bool await_ready() { return _m.try_lock(); }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            guard_t guard(_m._mutex);
+
+            if (!_m._locked) {
+                _m._locked = true;
+
+                return false;
+            }
+
+            _waiter._handle = handle;
+
+            if (_m._tail)
+                _m._tail->_next = &_waiter;
+            else
+                _m._head = &_waiter;
+
+            _m._tail = &_waiter;
+
+            return true;
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+    basic_async_mutex() = default;
+
+    basic_async_mutex(const basic_async_mutex&) = delete;
+    basic_async_mutex& operator=(const basic_async_mutex&) = delete;
+
+    lock_awaiter_t async_lock() { return lock_awaiter_t(*this); }
+
+    bool try_lock() {
+        guard_t guard(_mutex);
+
+        if (_locked)
+            return false;
+
+        _locked = true;
+
+        return true;
+    }
+
+    void unlock() {
+        waiter_t* next;
+
+        {
+            guard_t guard(_mutex);
+
+            next = _head;
+
+            if (next) {
+                _head = next->_next;
+
+                if (!_head)
+                    _tail = nullptr;
+            } else {
+                _locked = false;
+            }
+        }
+
+        if (next)
+            next->_handle.resume(); // _locked stays set; ownership passes on
+    }
+};
+
+using async_mutex_t = basic_async_mutex<ttas_spin_mutex_t>;
+
+/******************************************************************************/
+
+#endif // MUTEXPP_HAS_COROUTINES
+
 /******************************************************************************/
 
 } // namespace mutexpp
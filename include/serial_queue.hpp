@@ -11,7 +11,14 @@
 /******************************************************************************/
 
 // stdc++
+#include <functional>
 #include <future>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+// mutexpp
+#include "mutexpp.hpp"
 
 /******************************************************************************/
 
@@ -31,6 +38,73 @@
 
 /******************************************************************************/
 
+namespace mutexpp {
+
+/******************************************************************************/
+
+namespace detail {
+
+/******************************************************************************/
+// A burst of items and the function to apply to each, packaged as one task.
+// Calling it runs f over the items in order and yields either nothing or the
+// results, contiguously, if f returns anything. Shared by every backend's
+// async_batch and execute_batch.
+
+template <typename Item, typename F>
+class batch_task_t {
+    typedef decltype(std::declval<F&>()(std::declval<Item&>())) item_result_type;
+
+    // async() may hold its callable by const value; the task still runs
+    // exactly once, so handing f the items by non-const reference is fine.
+    mutable std::vector<Item> _items;
+    mutable F                 _f;
+
+    void run(std::true_type /* void */) const {
+        for (auto& item : _items)
+            _f(item);
+    }
+
+    std::vector<item_result_type> run(std::false_type /* void */) const {
+        std::vector<item_result_type> result;
+
+        result.reserve(_items.size());
+
+        for (auto& item : _items)
+            result.push_back(_f(item));
+
+        return result;
+    }
+
+public:
+    typedef typename std::conditional<std::is_void<item_result_type>::value,
+                                      void,
+                                      std::vector<item_result_type>>::type result_type;
+
+    template <typename I, typename G>
+    batch_task_t(I first, I last, G&& f) :
+        _items(first, last),
+        _f(std::forward<G>(f)) {
+    }
+
+    result_type operator()() const {
+        return run(typename std::is_void<item_result_type>::type());
+    }
+};
+
+template <typename I, typename F>
+using batch_task_for = batch_task_t<typename std::iterator_traits<I>::value_type,
+                                    typename std::decay<F>::type>;
+
+/******************************************************************************/
+
+} // namespace detail
+
+/******************************************************************************/
+
+} // namespace mutexpp
+
+/******************************************************************************/
+
 #if (MUTEXPP_SERIAL_QUEUE_IMPL == MUTEXPP_SERIAL_QUEUE_LIBDISPATCH)
 
 /******************************************************************************/
@@ -111,6 +185,44 @@ public:
         return result;
     }
 
+    // Fire-and-forget: no packaged_task, no future, one allocation.
+    template <class Function>
+    void execute(Function&& f) {
+        using function_type = detail::decay_t<Function>;
+
+        auto p = new function_type(std::forward<Function>(f));
+
+        dispatch_async_f(_q,
+                         p,
+                         [](void* f_) {
+                             function_type* f = static_cast<function_type*>(f_);
+                             (*f)();
+                             delete f;
+                         });
+    }
+
+    // Copies [first, last) into a single task that applies f to each item in
+    // order, so the whole burst costs one enqueue. The future holds the
+    // results, in order, unless f returns void.
+    template <class Iterator, class Function>
+    std::future<typename detail::batch_task_for<Iterator, Function>::result_type>
+    async_batch(Iterator first, Iterator last, Function&& f) {
+        return async(detail::batch_task_for<Iterator, Function>(first, last, std::forward<Function>(f)));
+    }
+
+    // As async_batch, but fire-and-forget.
+    template <class Iterator, class Function>
+    void execute_batch(Iterator first, Iterator last, Function&& f) {
+        execute(detail::batch_task_for<Iterator, Function>(first, last, std::forward<Function>(f)));
+    }
+
+#if MUTEXPP_HAS_COROUTINES
+    // co_await q.schedule() resumes the awaiting coroutine on this queue.
+    detail::schedule_awaiter_t<serial_queue_t> schedule() {
+        return detail::schedule_awaiter_t<serial_queue_t>{*this};
+    }
+#endif
+
     template <class Function, class... Args>
     detail::result_type<Function, Args...> sync(Function&& f, Args&&... args) {
         return async(std::forward<Function>(f), std::forward<Args>(args)...).get();
@@ -265,6 +377,41 @@ public:
         return result;
     }
 
+    // Fire-and-forget: no packaged_task, no future, one allocation.
+    template <class Function>
+    void execute(Function&& f) {
+        static const detail::mf_init_t init_s;
+
+        using function_type = typename std::decay<Function>::type;
+
+        auto p = new detail::async_wrapper<void, function_type>(std::forward<Function>(f));
+
+        if (MFPutWorkItem(_q, p, nullptr) != S_OK)
+            throw std::runtime_error("MFPutWorkItem failed");
+    }
+
+    // Copies [first, last) into a single task that applies f to each item in
+    // order, so the whole burst costs one enqueue. The future holds the
+    // results, in order, unless f returns void.
+    template <class Iterator, class Function>
+    std::future<typename detail::batch_task_for<Iterator, Function>::result_type>
+    async_batch(Iterator first, Iterator last, Function&& f) {
+        return async(detail::batch_task_for<Iterator, Function>(first, last, std::forward<Function>(f)));
+    }
+
+    // As async_batch, but fire-and-forget.
+    template <class Iterator, class Function>
+    void execute_batch(Iterator first, Iterator last, Function&& f) {
+        execute(detail::batch_task_for<Iterator, Function>(first, last, std::forward<Function>(f)));
+    }
+
+#if MUTEXPP_HAS_COROUTINES
+    // co_await q.schedule() resumes the awaiting coroutine on this queue.
+    detail::schedule_awaiter_t<serial_queue_t> schedule() {
+        return detail::schedule_awaiter_t<serial_queue_t>{*this};
+    }
+#endif
+
     template <class Function, class... Args>
     detail::result_type<Function, Args...> sync(Function&& f, Args&&... args) {
         return async(std::forward<Function>(f), std::forward<Args>(args)...).get();
@@ -281,9 +428,16 @@ public:
 
 /******************************************************************************/
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
-#include <deque>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 /******************************************************************************/
 
@@ -298,74 +452,766 @@ namespace detail {
 template <class Function, class... Args>
 using result_type = decltype(std::declval<Function>()(std::declval<Args>()...));
 
+/******************************************************************************/
+// Intrusive queue node. _invoke runs the task and then destroys it, but does
+// not release the storage it lives in.
+
+struct task_node_t {
+    std::atomic<task_node_t*> _next{nullptr};
+    void                      (*_invoke)(task_node_t*){nullptr};
+};
+
+/******************************************************************************/
+// Fixed-size task slot spanning two cache lines. Callables that fit are
+// constructed directly in _storage; larger ones are heap-allocated and only
+// their pointer lives here.
+
+struct task_slot_t : task_node_t {
+    enum : std::size_t {
+        size_k = 2 * cache_line_k,
+        storage_size_k = size_k - sizeof(task_node_t) - 2 * sizeof(std::uint32_t)
+    };
+
+    typedef typename std::aligned_storage<storage_size_k, alignof(void*)>::type storage_t;
+
+    std::atomic<std::uint32_t> _free_next{0}; // free list link, by index
+    std::uint32_t              _index{0};     // own index in the owning pool
+    storage_t                  _storage;
+};
+
+static_assert(sizeof(task_slot_t) == task_slot_t::size_k, "task_slot_t should fill its cache lines exactly");
+
+template <typename F>
+using fits_task_slot = std::integral_constant<bool, sizeof(F) <= sizeof(task_slot_t::storage_t) &&
+                                                    alignof(F) <= alignof(task_slot_t::storage_t)>;
+
+template <typename F>
+void invoke_inline_task(task_node_t* node) {
+    F& f = *reinterpret_cast<F*>(&static_cast<task_slot_t*>(node)->_storage);
+
+    f();
+    f.~F();
+}
+
+template <typename F>
+void invoke_heap_task(task_node_t* node) {
+    F* f = *reinterpret_cast<F**>(&static_cast<task_slot_t*>(node)->_storage);
+
+    (*f)();
+    delete f;
+}
+
+template <typename F, typename G>
+void construct_task(task_slot_t* slot, G&& g, std::true_type) {
+    ::new (&slot->_storage) F(std::forward<G>(g));
+    slot->_invoke = &invoke_inline_task<F>;
+}
+
+template <typename F, typename G>
+void construct_task(task_slot_t* slot, G&& g, std::false_type) {
+    ::new (&slot->_storage) F*(new F(std::forward<G>(g)));
+    slot->_invoke = &invoke_heap_task<F>;
+}
+
+/******************************************************************************/
+// Lock-free pool of task slots, so that steady-state submission allocates
+// nothing. Slots live in segments that double in size (8, 16, 32, ...) and are
+// never freed before the pool is, which keeps a slot index valid forever and
+// lets any thread find a slot from its index alone. Free slots form a Treiber
+// stack of indices; the head packs a 32-bit ABA tag alongside the index.
+
+class task_slot_pool_t {
+    enum : std::uint32_t {
+        base_k = 8, // slots in the first segment
+        segment_count_k = 24,
+        nil_k = 0xffffffff
+    };
+
+    std::atomic<task_slot_t*>  _segments[segment_count_k];
+    void*                      _raw[segment_count_k];
+    std::atomic<std::uint32_t> _segment_count{0};
+    std::atomic<std::uint64_t> _free{nil_k};
+
+    static std::uint32_t index_of(std::uint64_t head) {
+        return static_cast<std::uint32_t>(head);
+    }
+
+    static std::uint64_t retag(std::uint64_t head, std::uint32_t index) {
+        return (((head >> 32) + 1) << 32) | index;
+    }
+
+    task_slot_t* at(std::uint32_t index) const {
+        std::uint32_t n{index / base_k + 1};
+        std::uint32_t k{0};
+
+        while (n >>= 1)
+            ++k;
+
+        return _segments[k].load(std::memory_order_acquire) + (index - base_k * ((1u << k) - 1));
+    }
+
+    task_slot_t* grow() {
+        std::uint32_t k = _segment_count.fetch_add(1, std::memory_order_relaxed);
+
+        if (k >= segment_count_k)
+            throw std::bad_alloc();
+
+        std::uint32_t count{base_k << k};
+        std::uint32_t first{base_k * ((1u << k) - 1)};
+        void*         raw = ::operator new(count * sizeof(task_slot_t) + cache_line_k);
+        std::size_t   offset = cache_line_k - reinterpret_cast<std::uintptr_t>(raw) % cache_line_k;
+        task_slot_t*  slots = reinterpret_cast<task_slot_t*>(static_cast<char*>(raw) + offset);
+
+        for (std::uint32_t i(0); i < count; ++i) {
+            ::new (slots + i) task_slot_t();
+
+            slots[i]._index = first + i;
+            slots[i]._free_next.store(first + i + 1, std::memory_order_relaxed);
+        }
+
+        _raw[k] = raw;
+        _segments[k].store(slots, std::memory_order_release);
+
+        // Keep the first slot for the caller and donate the rest.
+        release(slots + 1, slots + count - 1);
+
+        return slots;
+    }
+
+public:
+    task_slot_pool_t() {
+        for (std::uint32_t k(0); k < segment_count_k; ++k) {
+            _segments[k].store(nullptr, std::memory_order_relaxed);
+            _raw[k] = nullptr;
+        }
+    }
+
+    task_slot_pool_t(const task_slot_pool_t&) = delete;
+    task_slot_pool_t& operator=(const task_slot_pool_t&) = delete;
+
+    ~task_slot_pool_t() {
+        for (auto& raw : _raw)
+            ::operator delete(raw);
+    }
+
+    task_slot_t* acquire() {
+        std::uint64_t head = _free.load(std::memory_order_acquire);
+
+        while (index_of(head) != nil_k) {
+            task_slot_t*  slot = at(index_of(head));
+            std::uint64_t next = retag(head, slot->_free_next.load(std::memory_order_relaxed));
+
+            if (_free.compare_exchange_weak(head,
+                                            next,
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire))
+                return slot;
+        }
+
+        return grow();
+    }
+
+    // Returns the chain first..last, already linked through _free_next.
+    void release(task_slot_t* first, task_slot_t* last) {
+        std::uint64_t head = _free.load(std::memory_order_relaxed);
+
+        do {
+            last->_free_next.store(index_of(head), std::memory_order_relaxed);
+        } while (!_free.compare_exchange_weak(head,
+                                              retag(head, first->_index),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+};
+
+/******************************************************************************/
+// Dmitry Vyukov's intrusive multi-producer/single-consumer queue. Producers
+// pay one exchange and one store; the consumer never executes an RMW except
+// when it has to re-insert the stub node. pop() returns nullptr both when the
+// queue is empty and when a producer has swapped the head but not yet linked
+// its node in, so callers need their own count to tell the two apart.
+
+class mpsc_queue_t {
+    std::atomic<task_node_t*> _head; // most recently pushed; producers only
+    task_node_t*              _tail; // next to pop; consumer only
+    task_node_t               _stub;
+
+public:
+    mpsc_queue_t() : _head(&_stub), _tail(&_stub) { }
+
+    mpsc_queue_t(const mpsc_queue_t&) = delete;
+    mpsc_queue_t& operator=(const mpsc_queue_t&) = delete;
+
+    void push(task_node_t* node) {
+        node->_next.store(nullptr, std::memory_order_relaxed);
+
+        task_node_t* prev = _head.exchange(node, std::memory_order_acq_rel);
+
+        prev->_next.store(node, std::memory_order_release);
+    }
+
+    task_node_t* pop() {
+        task_node_t* tail = _tail;
+        task_node_t* next = tail->_next.load(std::memory_order_acquire);
+
+        if (tail == &_stub) {
+            if (!next)
+                return nullptr;
+
+            _tail = next;
+            tail = next;
+            next = next->_next.load(std::memory_order_acquire);
+        }
+
+        if (next) {
+            _tail = next;
+
+            return tail;
+        }
+
+        if (tail != _head.load(std::memory_order_acquire))
+            return nullptr; // producer mid-push
+
+        push(&_stub);
+
+        next = tail->_next.load(std::memory_order_acquire);
+
+        if (next) {
+            _tail = next;
+
+            return tail;
+        }
+
+        return nullptr;
+    }
+};
+
+/******************************************************************************/
+// Intrusive unit of work for worker_pool_t, so scheduling never allocates.
+
+struct job_t {
+    void   (*_run)(job_t*){nullptr};
+    job_t* _next{nullptr}; // injection list link; guarded by the pool's mutex
+};
+
+/******************************************************************************/
+// Chase-Lev work-stealing deque, in the C11 formulation of Lê, Pop, Cohen and
+// Zappa Nardelli. The owning worker pushes and takes at the bottom without
+// any RMW in the common case; thieves take from the top with one CAS. The
+// ring grows by doubling; outgrown rings are kept until the deque dies since
+// a thief may still be reading one.
+
+class job_deque_t {
+    struct ring_t {
+        std::size_t                         _mask;
+        std::unique_ptr<std::atomic<job_t*>[]> _slots;
+
+        explicit ring_t(std::size_t size) :
+            _mask(size - 1),
+            _slots(new std::atomic<job_t*>[size]) { }
+
+        job_t* get(std::int64_t i) const {
+            return _slots[static_cast<std::size_t>(i) & _mask].load(std::memory_order_relaxed);
+        }
+
+        void put(std::int64_t i, job_t* job) {
+            _slots[static_cast<std::size_t>(i) & _mask].store(job, std::memory_order_relaxed);
+        }
+
+        std::size_t size() const { return _mask + 1; }
+    };
+
+    std::atomic<std::int64_t>            _top{0};
+    char                                 _pad[cache_line_k]; // keep thieves off of _bottom's line
+    std::atomic<std::int64_t>            _bottom{0};
+    std::atomic<ring_t*>                 _ring;
+    std::vector<std::unique_ptr<ring_t>> _rings; // owner only
+
+    ring_t* grow(ring_t* ring, std::int64_t top, std::int64_t bottom) {
+        _rings.emplace_back(new ring_t(ring->size() * 2));
+
+        ring_t* result = _rings.back().get();
+
+        for (std::int64_t i(top); i < bottom; ++i)
+            result->put(i, ring->get(i));
+
+        _ring.store(result, std::memory_order_release);
+
+        return result;
+    }
+
+public:
+    job_deque_t() {
+        _rings.emplace_back(new ring_t(64));
+        _ring.store(_rings.back().get(), std::memory_order_relaxed);
+    }
+
+    job_deque_t(const job_deque_t&) = delete;
+    job_deque_t& operator=(const job_deque_t&) = delete;
+
+    // Owner only.
+    void push(job_t* job) {
+        std::int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        std::int64_t top = _top.load(std::memory_order_acquire);
+        ring_t*      ring = _ring.load(std::memory_order_relaxed);
+
+        if (bottom - top > static_cast<std::int64_t>(ring->size()) - 1)
+            ring = grow(ring, top, bottom);
+
+        ring->put(bottom, job);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only.
+    job_t* take() {
+        std::int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+        ring_t*      ring = _ring.load(std::memory_order_relaxed);
+
+        _bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::int64_t top = _top.load(std::memory_order_relaxed);
+
+        if (top > bottom) { // empty
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+
+            return nullptr;
+        }
+
+        job_t* result = ring->get(bottom);
+
+        if (top == bottom) { // last one; race the thieves for it
+            if (!_top.compare_exchange_strong(top,
+                                              top + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed))
+                result = nullptr;
+
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+
+    job_t* steal() {
+        std::int64_t top = _top.load(std::memory_order_acquire);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::int64_t bottom = _bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+            return nullptr;
+
+        job_t* result = _ring.load(std::memory_order_acquire)->get(top);
+
+        if (!_top.compare_exchange_strong(top,
+                                          top + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed))
+            return nullptr; // lost to another thief or the owner
+
+        return result;
+    }
+
+    bool empty() const {
+        return _top.load(std::memory_order_acquire) >= _bottom.load(std::memory_order_acquire);
+    }
+};
+
 /******************************************************************************/
 
 } // namespace detail
 
 /******************************************************************************/
+// Work-stealing pool that portable serial queues are multiplexed onto, in the
+// manner of libdispatch's global queues. A serial queue only occupies the
+// pool while it has work, so an idle queue costs no thread.
+//
+// Each worker owns a Chase-Lev deque. Jobs scheduled from a worker go to the
+// bottom of its own deque, where they are taken LIFO while still cache-hot;
+// idle workers steal from the top of others'. Jobs scheduled from outside the
+// pool, and jobs that used up their quantum and must yield, go through a
+// shared FIFO injection list instead.
 
-class serial_queue_t {
+class worker_pool_t {
     typedef std::unique_lock<std::mutex> lock_t;
 
-    typedef std::pair<void(*)(void*), void*> pair_t;
+    struct worker_t {
+        const worker_pool_t* _pool;
+        std::size_t          _index;
+        detail::job_deque_t  _deque;
+        std::thread          _thread;
+
+        worker_t(const worker_pool_t* pool, std::size_t index) : _pool(pool), _index(index) { }
+    };
+
+    std::vector<std::unique_ptr<worker_t>> _workers;
+
+    std::mutex                _mutex; // guards the injection list and _epoch
+    detail::job_t*            _head{nullptr};
+    detail::job_t*            _tail{nullptr};
+    std::atomic<bool>         _injected{false}; // injection list non-empty
+    std::condition_variable   _ready;
+    std::uint64_t             _epoch{0};
+    std::atomic<std::size_t>  _sleeping{0};
+    std::atomic<bool>         _done{false};
+
+    static worker_t*& current_worker() {
+        thread_local worker_t* worker_s{nullptr};
 
-    std::mutex              _mutex;
-    std::condition_variable _ready;
-    std::deque<pair_t>      _queue;
-    bool                    _done{false};
-    std::thread             _executor;
+        return worker_s;
+    }
+
+    // The calling thread's worker, if it is one of ours.
+    worker_t* current() const {
+        worker_t* worker = current_worker();
+
+        return worker && worker->_pool == this ? worker : nullptr;
+    }
+
+    detail::job_t* pop_injected() {
+        if (!_injected.load(std::memory_order_acquire))
+            return nullptr;
+
+        lock_t         lock(_mutex);
+        detail::job_t* job = _head;
+
+        if (job) {
+            _head = job->_next;
+
+            if (!_head) {
+                _tail = nullptr;
+                _injected.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        return job;
+    }
+
+    detail::job_t* steal(std::size_t self) {
+        std::size_t count{_workers.size()};
+
+        for (std::size_t i(1); i < count; ++i)
+            if (detail::job_t* job = _workers[(self + i) % count]->_deque.steal())
+                return job;
+
+        return nullptr;
+    }
+
+    bool has_work() const {
+        if (_injected.load(std::memory_order_seq_cst))
+            return true;
+
+        for (const auto& worker : _workers)
+            if (!worker->_deque.empty())
+                return true;
+
+        return false;
+    }
+
+    // Called after making work visible. The fence orders the publication
+    // before the _sleeping load, pairing with the increment in run().
+    void wake_one() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!_sleeping.load(std::memory_order_relaxed))
+            return;
+
+        lock_t lock(_mutex);
+
+        ++_epoch;
+        lock.unlock();
+        _ready.notify_one();
+    }
+
+    void run(std::size_t self) {
+        worker_t& worker = *_workers[self];
+
+        current_worker() = &worker;
 
-    void run() {
         while (true) {
-            lock_t lock(_mutex);
+            detail::job_t* job = worker._deque.take();
+
+            if (!job)
+                job = pop_injected();
 
-            _ready.wait(lock, [this](){ return !_queue.empty() || _done; });
+            if (!job)
+                job = steal(self);
 
-            if (!_queue.empty()) {
-                pair_t pair = std::move(_queue.front());
+            if (job) {
+                job->_run(job);
+                continue;
+            }
+
+            // Nothing anywhere; go to sleep unless work shows up while we
+            // announce ourselves.
+            lock_t        lock(_mutex);
+            std::uint64_t epoch{_epoch};
+
+            _sleeping.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with wake_one()
 
-                _queue.pop_front();
+            lock.unlock();
 
-                lock.unlock();
+            if (has_work()) {
+                _sleeping.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
 
-                pair.first(pair.second);
-            } else if (_done) {
+            if (_done.load(std::memory_order_acquire)) {
+                _sleeping.fetch_sub(1, std::memory_order_relaxed);
                 break;
             }
+
+            lock.lock();
+
+            _ready.wait(lock, [&](){ return _epoch != epoch; });
+
+            _sleeping.fetch_sub(1, std::memory_order_relaxed);
         }
+
+        current_worker() = nullptr;
     }
 
-    template <typename TaskType>
-    static void invoke(void* p) {
-        TaskType* f = static_cast<TaskType*>(p);
-        (*f)();
-        delete f;
+public:
+    explicit worker_pool_t(std::size_t count = (std::max)(std::thread::hardware_concurrency(), 1u)) {
+        for (std::size_t i(0); i < count; ++i)
+            _workers.emplace_back(new worker_t(this, i));
+
+        // Workers steal from each other, so all deques must exist first.
+        for (std::size_t i(0); i < count; ++i)
+            _workers[i]->_thread = std::thread(&worker_pool_t::run, this, i);
     }
 
-    template <typename TaskType>
-    void dispatch(TaskType* task) {
-        pair_t pair{&invoke<TaskType>, task};
+    worker_pool_t(const worker_pool_t&) = delete;
+    worker_pool_t& operator=(const worker_pool_t&) = delete;
+
+    // Runs whatever is still scheduled, then joins the workers.
+    ~worker_pool_t() {
         lock_t lock(_mutex);
 
-        _queue.emplace_back(std::move(pair));
+        _done.store(true, std::memory_order_seq_cst);
+        ++_epoch;
+        lock.unlock();
+        _ready.notify_all();
+
+        for (auto& worker : _workers)
+            worker->_thread.join();
+    }
+
+    // Runs job soon, preferring the calling worker's own deque.
+    void schedule(detail::job_t* job) {
+        if (worker_t* worker = current()) {
+            worker->_deque.push(job);
+            wake_one();
+        } else {
+            requeue(job);
+        }
+    }
+
+    // Whether the calling thread is one of this pool's workers.
+    bool on_worker() const { return current() != nullptr; }
+
+    // Runs other jobs on the calling worker until done() holds. A worker that
+    // must wait for work scheduled on its own pool helps with it instead of
+    // blocking; blocked workers are workers the pool no longer has, and once
+    // all of them block nothing is left to run the work they wait for.
+    template <typename F>
+    void help(F done) {
+        worker_t& worker = *current();
+
+        while (!done()) {
+            detail::job_t* job = worker._deque.take();
+
+            if (!job)
+                job = pop_injected();
+
+            if (!job)
+                job = steal(worker._index);
+
+            if (job)
+                job->_run(job);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // Runs job after everything already injected; used by jobs yielding
+    // their worker so they cannot monopolize it.
+    void requeue(detail::job_t* job) {
+        lock_t lock(_mutex);
+
+        job->_next = nullptr;
+
+        if (_tail)
+            _tail->_next = job;
+        else
+            _head = job;
+
+        _tail = job;
+
+        _injected.store(true, std::memory_order_relaxed);
 
         lock.unlock();
 
-        _ready.notify_one();
+        wake_one();
+    }
+
+    // The process-wide pool used by default. It is deliberately never
+    // destroyed, so queues with static storage duration can still drain
+    // during exit.
+    static worker_pool_t& shared() {
+        static worker_pool_t* pool_s = new worker_pool_t();
+
+        return *pool_s;
+    }
+};
+
+/******************************************************************************/
+// A serial queue is a task list plus a count of submitted-but-unrun tasks. The
+// producer that moves the count off of zero schedules the queue on the pool;
+// the worker running it only hands it back when it drains the count to zero,
+// otherwise it requeues it. Hence the queue runs on at most one worker at a
+// time -- its drain job may be stolen, but only as a unit -- and the acq_rel
+// count carries the consumer-side state of _queue from one worker to the
+// next.
+//
+// Tasks share a fixed set of workers, so a task must not block waiting on
+// other pool work (a future's get() or wait(), say): each blocked task takes
+// a worker away, and once every worker is blocked nothing runs the work they
+// wait for. Destroying a queue from a task is fine, since the destructor
+// helps run the pool's jobs rather than blocking, unless the task belongs to
+// that queue, which can never drain while the task is still running.
+
+class serial_queue_t : private detail::job_t {
+    enum : std::size_t {
+        release_batch_k = 32,
+        quantum_k = 256 // tasks per turn on a worker before letting others in
+    };
+
+    detail::task_slot_pool_t _pool;
+    detail::mpsc_queue_t     _queue;
+    std::atomic<std::size_t> _pending{0};
+    worker_pool_t&           _workers;
+
+    // Runs up to max tasks that are reachable right now. Spent slots go back
+    // to the pool in chains, so the pool sees one CAS per release_batch_k
+    // tasks. Returns the number of tasks run.
+    std::size_t drain(std::size_t max) {
+        std::size_t          count{0};
+        detail::task_slot_t* first{nullptr};
+        detail::task_slot_t* last{nullptr};
+
+        while (count < max) {
+            detail::task_node_t* node = _queue.pop();
+
+            if (!node)
+                break;
+
+            auto slot = static_cast<detail::task_slot_t*>(node);
+
+#if MUTEXPP_ENABLE_TRACE
+            trace::record(trace::task_start_k, this);
+#endif
+
+            slot->_invoke(slot);
+
+#if MUTEXPP_ENABLE_TRACE
+            trace::record(trace::task_finish_k, this);
+#endif
+
+            if (first) {
+                slot->_free_next.store(first->_index, std::memory_order_relaxed);
+            } else {
+                last = slot;
+            }
+
+            first = slot;
+
+            if (++count % release_batch_k == 0) {
+                _pool.release(first, last);
+                first = nullptr;
+            }
+        }
+
+        if (first)
+            _pool.release(first, last);
+
+        return count;
+    }
+
+    static void run(detail::job_t* job) {
+        static_cast<serial_queue_t*>(job)->run_quantum();
+    }
+
+    void run_quantum() {
+        std::size_t count;
+
+        // _pending can count a task whose producer has not linked it in yet.
+        while (!(count = drain(quantum_k)))
+            std::this_thread::yield();
+
+        // Nothing may touch *this after the count reaches zero; the queue may
+        // be destroyed from that point on.
+        if (_pending.fetch_sub(count, std::memory_order_acq_rel) != count)
+            _workers.requeue(this);
+    }
+
+    template <typename F, typename G>
+    void dispatch(G&& g) {
+        detail::task_slot_t* slot = _pool.acquire();
+
+        try {
+            detail::construct_task<F>(slot, std::forward<G>(g), detail::fits_task_slot<F>());
+        } catch (...) {
+            _pool.release(slot, slot);
+            throw;
+        }
+
+#if MUTEXPP_ENABLE_TRACE
+        trace::record(trace::task_enqueue_k, this);
+#endif
+
+        bool idle = _pending.fetch_add(1, std::memory_order_acq_rel) == 0;
+
+        _queue.push(slot);
+
+        if (idle)
+            _workers.schedule(this);
     }
 
 public:
-    serial_queue_t() :
-        _executor(&serial_queue_t::run, this)
-    { }
+    explicit serial_queue_t(worker_pool_t& workers = worker_pool_t::shared()) :
+        _workers(workers) {
+        _run = &run;
+    }
 
+    serial_queue_t(const serial_queue_t&) = delete;
+    serial_queue_t& operator=(const serial_queue_t&) = delete;
+
+    // Like the thread-per-queue design before it, destruction waits for every
+    // task already submitted to run. On one of the pool's own workers it runs
+    // jobs in the meantime, the queue's among them.
     ~serial_queue_t() {
-        lock_t lock(_mutex);
+        if (_workers.on_worker()) {
+            _workers.help([this](){ return !_pending.load(std::memory_order_acquire); });
 
-        _done = true;
-        lock.unlock();
-        _ready.notify_one();
-        _executor.join();
+            return;
+        }
+
+        if (_pending.load(std::memory_order_acquire)) {
+            std::promise<void> drained;
+
+            execute([&drained](){ drained.set_value(); });
+
+            drained.get_future().wait();
+        }
+
+        // The worker still has to retire the final batch.
+        while (_pending.load(std::memory_order_acquire))
+            std::this_thread::yield();
     }
 
     template <class Function, class... Args>
@@ -373,16 +1219,47 @@ public:
         using result_type = detail::result_type<Function, Args...>;
         using packaged_type = std::packaged_task<result_type()>;
 
-        auto p = new packaged_type(std::bind([f](Args&&... args) {
+        packaged_type p(std::bind([f](Args&&... args) {
             return f(std::move(args)...);
         }, std::forward<Args>(args)...));
 
-        auto result = p->get_future();
+        auto result = p.get_future();
 
-        dispatch(p);
+        dispatch<packaged_type>(std::move(p));
 
         return result;
     }
+
+    // Fire-and-forget: no packaged_task and no future. Callables that fit in a
+    // task slot are built in place, so this does not allocate at all.
+    template <class Function>
+    void execute(Function&& f) {
+        using function_type = typename std::decay<Function>::type;
+
+        dispatch<function_type>(std::forward<Function>(f));
+    }
+
+    // Copies [first, last) into a single task that applies f to each item in
+    // order, so the whole burst costs one enqueue. The future holds the
+    // results, in order, unless f returns void.
+    template <class Iterator, class Function>
+    std::future<typename detail::batch_task_for<Iterator, Function>::result_type>
+    async_batch(Iterator first, Iterator last, Function&& f) {
+        return async(detail::batch_task_for<Iterator, Function>(first, last, std::forward<Function>(f)));
+    }
+
+    // As async_batch, but fire-and-forget.
+    template <class Iterator, class Function>
+    void execute_batch(Iterator first, Iterator last, Function&& f) {
+        execute(detail::batch_task_for<Iterator, Function>(first, last, std::forward<Function>(f)));
+    }
+
+#if MUTEXPP_HAS_COROUTINES
+    // co_await q.schedule() resumes the awaiting coroutine on this queue.
+    detail::schedule_awaiter_t<serial_queue_t> schedule() {
+        return detail::schedule_awaiter_t<serial_queue_t>{*this};
+    }
+#endif
 };
 
 /******************************************************************************/
@@ -411,10 +1288,37 @@ public:
     explicit serial_wrapper(Args&&... args) : _r(std::forward<Args>(args)...) {
     }
 
+#if (MUTEXPP_SERIAL_QUEUE_IMPL == MUTEXPP_SERIAL_QUEUE_PORTABLE)
+    // Binds the wrapped resource's queue to a pool other than the shared one.
+    template <typename... Args>
+    explicit serial_wrapper(worker_pool_t& pool, Args&&... args) :
+        _q(pool),
+        _r(std::forward<Args>(args)...) {
+    }
+#endif
+
     template <typename F>
     auto operator()(F&& f) -> decltype(_q.async(std::bind(std::forward<F>(f), std::ref(_r)))) {
         return _q.async(std::bind(std::forward<F>(f), std::ref(_r)));
     }
+
+    // Like operator(), but any result is discarded and no future is made.
+    template <typename F>
+    void post(F&& f) {
+        _q.execute(std::bind(std::forward<F>(f), std::ref(_r)));
+    }
+
+    // Applies f(resource, item) to each of [first, last) as one task.
+    template <typename I, typename F>
+    auto async_batch(I first, I last, F&& f) -> decltype(_q.async_batch(first, last, std::bind(std::forward<F>(f), std::ref(_r), std::placeholders::_1))) {
+        return _q.async_batch(first, last, std::bind(std::forward<F>(f), std::ref(_r), std::placeholders::_1));
+    }
+
+    // As async_batch, but any results are discarded and no future is made.
+    template <typename I, typename F>
+    void post_batch(I first, I last, F&& f) {
+        _q.execute_batch(first, last, std::bind(std::forward<F>(f), std::ref(_r), std::placeholders::_1));
+    }
 };
 
 /******************************************************************************/
@@ -0,0 +1,277 @@
+/******************************************************************************/
+// Flat-combining synchronized wrapper by Foster Brereton.
+//
+// Distributed under the MIT License. (See accompanying LICENSE.md or copy at
+// https://opensource.org/licenses/MIT)
+/******************************************************************************/
+
+#ifndef MUTEXPP_SYNCHRONIZED_HPP__
+#define MUTEXPP_SYNCHRONIZED_HPP__
+
+/******************************************************************************/
+
+// stdc++
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// mutexpp
+#include "mutexpp.hpp"
+
+/******************************************************************************/
+
+namespace mutexpp {
+
+/******************************************************************************/
+
+namespace detail {
+
+/******************************************************************************/
+// An operation published for a combiner to run. It lives on the caller's
+// stack, which is safe because the caller waits for _done before returning;
+// once a combiner has set _done it must not touch the request again.
+
+template <typename T>
+struct combining_request_t {
+    void (*_run)(combining_request_t&, T&);
+    std::atomic<bool> _done{false};
+
+    explicit combining_request_t(void (*run)(combining_request_t&, T&)) : _run(run) { }
+};
+
+// Where a request's outcome lands: the result, unless R is void, or the
+// exception the operation threw. Built in place by the combiner.
+template <typename R>
+class combining_result_t {
+    typename std::aligned_storage<sizeof(R), alignof(R)>::type _storage;
+    bool                                                       _valid{false};
+    std::exception_ptr                                         _error;
+
+public:
+    combining_result_t() = default;
+
+    combining_result_t(const combining_result_t&) = delete;
+    combining_result_t& operator=(const combining_result_t&) = delete;
+
+    ~combining_result_t() {
+        if (_valid)
+            reinterpret_cast<R*>(&_storage)->~R();
+    }
+
+    template <typename F, typename T>
+    void run(F& f, T& value) {
+        try {
+            ::new (static_cast<void*>(&_storage)) R(f(value));
+            _valid = true;
+        } catch (...) {
+            _error = std::current_exception();
+        }
+    }
+
+    R get() {
+        if (_error)
+            std::rethrow_exception(_error);
+
+        return std::move(*reinterpret_cast<R*>(&_storage));
+    }
+};
+
+template <>
+class combining_result_t<void> {
+    std::exception_ptr _error;
+
+public:
+    template <typename F, typename T>
+    void run(F& f, T& value) {
+        try {
+            f(value);
+        } catch (...) {
+            _error = std::current_exception();
+        }
+    }
+
+    void get() {
+        if (_error)
+            std::rethrow_exception(_error);
+    }
+};
+
+template <typename T, typename F>
+struct combining_call_t : combining_request_t<T> {
+    typedef typename std::remove_reference<F>::type function_type;
+    typedef typename std::decay<decltype(std::declval<function_type&>()(std::declval<T&>()))>::type result_type;
+
+    function_type&                  _f;
+    combining_result_t<result_type> _result;
+
+    explicit combining_call_t(function_type& f) : combining_request_t<T>(&run), _f(f) { }
+
+    static void run(combining_request_t<T>& request, T& value) {
+        combining_call_t& call = static_cast<combining_call_t&>(request);
+
+        call._result.run(call._f, value);
+
+        call._done.store(true, std::memory_order_release);
+    }
+};
+
+/******************************************************************************/
+
+} // namespace detail
+
+/******************************************************************************/
+// A T only reachable through operator()(f), which calls f(T&) under Mutex and
+// returns its result, as serial_wrapper's operator() does, but synchronously
+// and without a hop to another thread or an allocation.
+//
+// Callers publish their operation in a slot and whichever of them takes the
+// lock becomes the combiner, running every published operation in one pass
+// before it unlocks. T stays hot in the combiner's cache, and the others only
+// wait for their own request's _done flag, which lives on their own stacks. A
+// waiter tries the lock now and then in case the combiner has moved on, and
+// after spin_limit_k attempts blocks in Mutex::lock(), so combining degrades
+// to plain locking when waits run long.
+//
+// A thread's home slot comes from its thread record's index; a thread that
+// finds it taken probes onward, and one that finds every slot taken locks the
+// mutex outright. Exceptions from f are rethrown to its caller.
+
+template <typename T, typename Mutex = adaptive_futex_mutex_t>
+class synchronized {
+    enum : std::size_t {
+        slot_count_k = 64,
+        pass_limit_k = 4,  // scans per combine, while they keep finding work
+        try_lock_every_k = 16,
+        spin_limit_k = 1024
+    };
+
+    typedef detail::combining_request_t<T> request_t;
+
+    struct alignas(detail::cache_line_k) slot_t {
+        std::atomic<request_t*> _request{nullptr};
+    };
+
+    slot_t                   _slots[slot_count_k];
+    std::atomic<std::size_t> _slot_high{0}; // every slot ever used is below this
+    Mutex                    _mutex;
+    T                        _value;
+
+    bool publish(request_t& request) {
+        std::size_t home = detail::this_thread_record()._index;
+
+        for (std::size_t probe(0); probe < slot_count_k; ++probe) {
+            std::size_t i = (home + probe) % slot_count_k;
+            request_t*  expected = nullptr;
+
+            if (!_slots[i]._request.compare_exchange_strong(expected,
+                                                            &request,
+                                                            std::memory_order_release,
+                                                            std::memory_order_relaxed))
+                continue;
+
+            std::size_t high = _slot_high.load(std::memory_order_relaxed);
+
+            while (high < i + 1 && !_slot_high.compare_exchange_weak(high, i + 1, std::memory_order_relaxed))
+                ;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    // With the lock held. A slot is cleared before its request runs, since
+    // the request may be gone by the time run() returns.
+    void combine() {
+        for (std::size_t pass(0); pass < pass_limit_k; ++pass) {
+            std::size_t high = _slot_high.load(std::memory_order_relaxed);
+            bool        found{false};
+
+            for (std::size_t i(0); i < high; ++i) {
+                request_t* request = _slots[i]._request.load(std::memory_order_acquire);
+
+                if (!request)
+                    continue;
+
+                _slots[i]._request.store(nullptr, std::memory_order_relaxed);
+
+                request->_run(*request, _value);
+
+                found = true;
+            }
+
+            if (!found)
+                return;
+        }
+    }
+
+public:
+    typedef T value_type;
+
+    template <typename... Args>
+    explicit synchronized(Args&&... args) : _value(std::forward<Args>(args)...) {
+    }
+
+    synchronized(const synchronized&) = delete;
+    synchronized& operator=(const synchronized&) = delete;
+
+    template <typename F>
+    typename detail::combining_call_t<T, F>::result_type operator()(F&& f) {
+        detail::combining_call_t<T, F> call(f);
+
+        // Uncontended, run f directly, and help anyone who has shown up since.
+        if (_mutex.try_lock()) {
+            call._run(call, _value);
+
+            combine();
+
+            _mutex.unlock();
+
+            return call._result.get();
+        }
+
+        if (!publish(call)) {
+            std::lock_guard<Mutex> lock(_mutex);
+
+            call._run(call, _value);
+
+            combine();
+
+            return call._result.get();
+        }
+
+        for (std::size_t spin_count(1); !call._done.load(std::memory_order_acquire); ++spin_count) {
+            if (spin_count < spin_limit_k) {
+                if (spin_count % try_lock_every_k || !_mutex.try_lock()) {
+                    detail::cpu_relax();
+
+                    continue;
+                }
+            } else {
+                _mutex.lock();
+            }
+
+            // Our request is published, so this pass runs it if no one has.
+            combine();
+
+            _mutex.unlock();
+        }
+
+        return call._result.get();
+    }
+};
+
+/******************************************************************************/
+
+} // namespace mutexpp
+
+/******************************************************************************/
+
+#endif // MUTEXPP_SYNCHRONIZED_HPP__
+
+/******************************************************************************/
@@ -0,0 +1,351 @@
+/******************************************************************************/
+// Event tracing by Foster Brereton.
+//
+// Distributed under the MIT License. (See accompanying LICENSE.md or copy at
+// https://opensource.org/licenses/MIT)
+/******************************************************************************/
+
+#ifndef MUTEXPP_TRACE_HPP__
+#define MUTEXPP_TRACE_HPP__
+
+/******************************************************************************/
+
+// stdc++
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+// mutexpp
+#include "clock.hpp"
+
+/******************************************************************************/
+
+#ifndef MUTEXPP_TRACE_CAPACITY
+    #define MUTEXPP_TRACE_CAPACITY 65536 // events per thread; a power of two
+#endif
+
+/******************************************************************************/
+
+namespace mutexpp {
+
+/******************************************************************************/
+
+namespace trace {
+
+/******************************************************************************/
+
+enum event_kind_t : std::uint32_t {
+    lock_wait_k,    // a lock() found the mutex held
+    lock_acquire_k,
+    lock_release_k,
+    task_enqueue_k, // a task was submitted to a serial queue
+    task_start_k,
+    task_finish_k
+};
+
+// Fixed layout, since buffers are dumped as raw bytes and read back later.
+struct event_t {
+    std::uint64_t _time;   // ticks of clock()
+    std::uint64_t _object; // address of the mutex or queue involved
+    std::uint32_t _kind;
+    std::uint32_t _reserved;
+};
+
+static_assert(sizeof(event_t) == 24, "trace::event_t must stay 24 bytes");
+
+/******************************************************************************/
+
+namespace detail {
+
+/******************************************************************************/
+// Ticks are raw cycle counts, converted to time when the trace is dumped, not
+// when recorded.
+
+inline std::uint64_t clock() { return mutexpp::detail::cycle_count(); }
+
+inline std::uint64_t steady_ns() { return mutexpp::detail::steady_ns(); }
+
+/******************************************************************************/
+// Single-writer ring of events. Only the owning thread writes; _count is
+// published with release so a dump sees whole events, but a dump is only
+// meaningful once the traced threads have gone quiet.
+
+struct buffer_t {
+    enum : std::size_t {
+        capacity_k = MUTEXPP_TRACE_CAPACITY,
+        mask_k = capacity_k - 1
+    };
+
+    static_assert((capacity_k & mask_k) == 0, "MUTEXPP_TRACE_CAPACITY must be a power of two");
+
+    event_t                    _events[capacity_k];
+    std::atomic<std::uint64_t> _count{0};
+    std::uint32_t              _thread;
+    buffer_t*                  _next{nullptr}; // registry link; set once
+    buffer_t*                  _next_free{nullptr}; // free list link
+
+    explicit buffer_t(std::uint32_t thread) : _thread(thread) { }
+
+    void push(event_kind_t kind, const void* object) {
+        std::uint64_t count = _count.load(std::memory_order_relaxed);
+        event_t&      event = _events[count & mask_k];
+
+        event._time = clock();
+        event._object = reinterpret_cast<std::uintptr_t>(object);
+        event._kind = kind;
+        event._reserved = 0;
+
+        _count.store(count + 1, std::memory_order_release);
+    }
+};
+
+/******************************************************************************/
+// Every buffer ever made, kept forever so a dump after a thread has exited
+// still sees its events. An exiting thread returns its buffer to a free list
+// and the next thread to enroll takes it over, appending after the events
+// already there, so a program that keeps starting threads holds only as many
+// buffers as it ever had threads alive at once. A reused buffer keeps its
+// thread number, so its threads share one track in the trace; they never
+// overlapped in time. Enrollment happens once per thread, so it is the only
+// place tracing locks or allocates.
+
+class registry_t {
+    std::atomic<buffer_t*>     _head{nullptr};
+    std::mutex                 _free_mutex;
+    buffer_t*                  _free{nullptr};
+    std::atomic<std::uint32_t> _next_thread{0};
+    std::uint64_t              _tick_start{clock()};
+    std::uint64_t              _ns_start{steady_ns()};
+
+public:
+    buffer_t* enroll() {
+        /* reuse */ {
+            std::lock_guard<std::mutex> lock(_free_mutex);
+
+            if (buffer_t* buffer = _free) {
+                _free = buffer->_next_free;
+
+                return buffer;
+            }
+        }
+
+        buffer_t* buffer = new buffer_t(_next_thread.fetch_add(1, std::memory_order_relaxed));
+        buffer_t* head = _head.load(std::memory_order_relaxed);
+
+        do {
+            buffer->_next = head;
+        } while (!_head.compare_exchange_weak(head,
+                                              buffer,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+
+        return buffer;
+    }
+
+    void retire(buffer_t* buffer) {
+        std::lock_guard<std::mutex> lock(_free_mutex);
+
+        buffer->_next_free = _free;
+        _free = buffer;
+    }
+
+    buffer_t* head() const { return _head.load(std::memory_order_acquire); }
+
+    // Calibrates clock() against the steady clock over the life of the trace.
+    double ticks_per_us() const {
+        std::uint64_t ticks = clock() - _tick_start;
+        std::uint64_t ns = steady_ns() - _ns_start;
+
+        return ns && ticks ? ticks * 1000. / ns : 1000.;
+    }
+};
+
+inline registry_t& registry() {
+    static registry_t* registry_s = new registry_t(); // outlives every thread
+
+    return *registry_s;
+}
+
+// Holds the calling thread's buffer and hands it back when the thread exits.
+struct thread_slot_t {
+    buffer_t* _buffer{registry().enroll()};
+
+    ~thread_slot_t() { registry().retire(_buffer); }
+};
+
+inline buffer_t& thread_buffer() {
+    thread_local thread_slot_t slot_s;
+
+    return *slot_s._buffer;
+}
+
+/******************************************************************************/
+
+template <typename T>
+void write_pod(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T read_pod(std::istream& in) {
+    T value;
+
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(T)))
+        throw std::runtime_error("truncated trace");
+
+    return value;
+}
+
+enum : std::uint32_t {
+    magic_k = 0x5254584d, // "MXTR"
+    version_k = 1
+};
+
+/******************************************************************************/
+
+} // namespace detail
+
+/******************************************************************************/
+// Appends an event to the calling thread's ring. No locks and, after the
+// thread's first event, no allocation. Once a ring is full the oldest events
+// are overwritten.
+
+inline void record(event_kind_t kind, const void* object) {
+    detail::thread_buffer().push(kind, object);
+}
+
+/******************************************************************************/
+// Writes every thread's ring to out in a compact binary form. Call it once the
+// traced work has quiesced; events recorded during the dump may be torn.
+
+inline void dump(std::ostream& out) {
+    detail::write_pod(out, std::uint32_t(detail::magic_k));
+    detail::write_pod(out, std::uint32_t(detail::version_k));
+    detail::write_pod(out, detail::registry().ticks_per_us());
+
+    for (detail::buffer_t* buffer = detail::registry().head(); buffer; buffer = buffer->_next) {
+        std::uint64_t count = buffer->_count.load(std::memory_order_acquire);
+        std::uint64_t first = count > detail::buffer_t::capacity_k ? count - detail::buffer_t::capacity_k : 0;
+
+        detail::write_pod(out, buffer->_thread);
+        detail::write_pod(out, count - first);
+
+        for (std::uint64_t i(first); i < count; ++i)
+            detail::write_pod(out, buffer->_events[i & detail::buffer_t::mask_k]);
+    }
+}
+
+/******************************************************************************/
+// Converts a dump into Chrome trace event JSON, which chrome://tracing and
+// Perfetto both open. Lock waits and holds, and serial queue tasks, become
+// duration slices on their thread's track; enqueues become instant events.
+
+inline void convert_to_chrome(std::istream& in, std::ostream& out) {
+    if (detail::read_pod<std::uint32_t>(in) != detail::magic_k)
+        throw std::runtime_error("not a mutexpp trace");
+
+    if (detail::read_pod<std::uint32_t>(in) != detail::version_k)
+        throw std::runtime_error("unsupported trace version");
+
+    double ticks_per_us = detail::read_pod<double>(in);
+
+    struct thread_events_t {
+        std::uint32_t        _thread;
+        std::vector<event_t> _events;
+    };
+
+    std::vector<thread_events_t> threads;
+    std::uint64_t                origin = UINT64_MAX;
+
+    while (in.peek() != std::char_traits<char>::eof()) {
+        thread_events_t thread;
+
+        thread._thread = detail::read_pod<std::uint32_t>(in);
+        thread._events.resize(detail::read_pod<std::uint64_t>(in));
+
+        for (auto& event : thread._events) {
+            event = detail::read_pod<event_t>(in);
+            origin = (std::min)(origin, event._time);
+        }
+
+        threads.push_back(std::move(thread));
+    }
+
+    const char* separator = "";
+
+    auto emit = [&](const char* name, const char* phase, std::uint32_t tid, const event_t& event) {
+        out << separator
+            << "{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\""
+            << ",\"pid\":1,\"tid\":" << tid
+            << ",\"ts\":" << std::fixed << std::setprecision(3) << (event._time - origin) / ticks_per_us
+            << ",\"args\":{\"object\":\"0x" << std::hex << event._object << std::dec << "\"}";
+
+        if (phase[0] == 'i')
+            out << ",\"s\":\"t\"";
+
+        out << "}";
+
+        separator = ",\n";
+    };
+
+    out << "{\"traceEvents\":[\n";
+
+    for (const auto& thread : threads) {
+        std::map<std::uint64_t, bool> waiting; // object -> wait slice open
+
+        for (const auto& event : thread._events) {
+            switch (event._kind) {
+                case lock_wait_k:
+                    waiting[event._object] = true;
+                    emit("lock wait", "B", thread._thread, event);
+                    break;
+                case lock_acquire_k:
+                    if (waiting[event._object]) {
+                        waiting[event._object] = false;
+                        emit("lock wait", "E", thread._thread, event);
+                    }
+
+                    emit("lock held", "B", thread._thread, event);
+                    break;
+                case lock_release_k:
+                    emit("lock held", "E", thread._thread, event);
+                    break;
+                case task_enqueue_k:
+                    emit("task enqueue", "i", thread._thread, event);
+                    break;
+                case task_start_k:
+                    emit("task", "B", thread._thread, event);
+                    break;
+                case task_finish_k:
+                    emit("task", "E", thread._thread, event);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+/******************************************************************************/
+
+} // namespace trace
+
+/******************************************************************************/
+
+} // namespace mutexpp
+
+/******************************************************************************/
+
+#endif // MUTEXPP_TRACE_HPP__
+
+/******************************************************************************/
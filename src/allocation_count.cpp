@@ -0,0 +1,50 @@
+/******************************************************************************/
+// Mutex adaptors by Foster Brereton.
+//
+// Distributed under the MIT License. (See accompanying LICENSE.md or copy at
+// https://opensource.org/licenses/MIT)
+/******************************************************************************/
+
+// stdc++
+#include <cstdlib>
+#include <new>
+
+// application
+#include "allocation_count.hpp"
+
+/******************************************************************************/
+
+namespace {
+
+/******************************************************************************/
+
+thread_local std::size_t allocation_count_s{0};
+
+/******************************************************************************/
+
+} // namespace
+
+/******************************************************************************/
+
+std::size_t allocation_count() {
+    return allocation_count_s;
+}
+
+/******************************************************************************/
+// Replacements for the global allocation functions. The array, nothrow and
+// sized forms forward to these by default, so these are the only ones needed.
+
+void* operator new(std::size_t size) {
+    ++allocation_count_s;
+
+    if (void* result = std::malloc(size ? size : 1))
+        return result;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+/******************************************************************************/
@@ -0,0 +1,25 @@
+/******************************************************************************/
+// Mutex adaptors by Foster Brereton.
+//
+// Distributed under the MIT License. (See accompanying LICENSE.md or copy at
+// https://opensource.org/licenses/MIT)
+/******************************************************************************/
+
+#ifndef ALLOCATION_COUNT_HPP__
+#define ALLOCATION_COUNT_HPP__
+
+/******************************************************************************/
+
+#include <cstddef>
+
+/******************************************************************************/
+
+// Number of global operator new calls made so far by the calling thread. The
+// count is thread-local so that keeping it costs the benchmarks no contention.
+std::size_t allocation_count();
+
+/******************************************************************************/
+
+#endif // ALLOCATION_COUNT_HPP__
+
+/******************************************************************************/
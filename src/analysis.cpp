@@ -80,3 +80,20 @@ normal_analysis_t normal_analysis(const std::vector<double>& normal_data) {
 }
 
 /******************************************************************************/
+
+double jain_fairness(const std::vector<double>& throughputs) {
+    if (throughputs.empty())
+        throw std::runtime_error("data empty.");
+
+    double sum{0};
+    double sum_sq{0};
+
+    for (const auto& x : throughputs) {
+        sum += x;
+        sum_sq += x * x;
+    }
+
+    return sum_sq == 0 ? 1 : (sum * sum) / (throughputs.size() * sum_sq);
+}
+
+/******************************************************************************/
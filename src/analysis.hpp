@@ -30,6 +30,10 @@ normal_analysis_t normal_analysis(const std::vector<double>& normal_data);
 
 void normal_analysis_header(std::ostream& s);
 
+// Jain's fairness index of per-participant throughput: 1 when every
+// participant got an equal share, down to 1/n when one got everything.
+double jain_fairness(const std::vector<double>& throughputs);
+
 /******************************************************************************/
 
 #endif // ANALYSIS_HPP__
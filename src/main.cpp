@@ -6,28 +6,44 @@
 /******************************************************************************/
 
 // stdc++
+#include <array>
+#include <condition_variable>
 #include <ctime>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <string>
+#include <system_error>
 #include <vector>
 #include <map>
 
+#if __linux__
+    #include <unistd.h>
+#endif
+
 // tbb
 #include <tbb/mutex.h>
 #include <tbb/spin_mutex.h>
 
 #define MUTEXPP_SERIAL_QUEUE_IMPL 0 // portable
 
-#define MUTEXPP_ENABLE_PROBE 0
+#define MUTEXPP_ENABLE_TRACE 0 // serial queue task events
+
+#define MUTEXPP_TRACE_CAPACITY 4096 // events per thread; mutex_trace() starts many threads
 
 // mutexpp
 #include "mutexpp.hpp"
 #include "serial_queue.hpp"
+#include "future.hpp"
+#include "synchronized.hpp"
+#include "trace.hpp"
 
 // application
+#include "allocation_count.hpp"
 #include "analysis.hpp"
 
 /******************************************************************************/
@@ -43,6 +59,23 @@ static const std::size_t thread_exact_k = std::thread::hardware_concurrency();
 static const std::size_t thread_under_k = thread_exact_k / 2;
 static const std::size_t thread_over_k = thread_exact_k * 2;
 
+/******************************************************************************/
+// adaptive_block_mutex_t's earlier design, kept for comparison: waiters sleep
+// for the predicted hold time, measured on every acquisition, and retry.
+
+using sleep_block_mutex_t = basic_mutex<policy::tas_t,
+                                        policy::no_backoff_t,
+                                        policy::sleep_wait_t,
+                                        policy::hold_predictor_t<3, 1>>;
+
+// adaptive_spin_mutex_t's earlier design, kept for comparison: the spin budget
+// is twice the average spin count over every acquisition, in attempts.
+
+using spin_count_mutex_t = basic_mutex<policy::tas_t,
+                                       policy::no_backoff_t,
+                                       policy::sleep_wait_t,
+                                       policy::ema_predictor_t<3>>;
+
 /******************************************************************************/
 
 template <typename T>
@@ -57,15 +90,155 @@ std::string pretty_type<tbb::spin_mutex>() { return "tbb/spin"; }
 template <>
 std::string pretty_type<spin_mutex_t>() { return "spin"; }
 
+template <>
+std::string pretty_type<ttas_spin_mutex_t>() { return "ttas spin"; }
+
 template <>
 std::string pretty_type<adaptive_spin_mutex_t>() { return "adaptive spin"; }
 
 template <>
 std::string pretty_type<adaptive_block_mutex_t>() { return "adaptive block"; }
 
+template <>
+std::string pretty_type<sleep_block_mutex_t>() { return "sleep block"; }
+
+template <>
+std::string pretty_type<spin_count_mutex_t>() { return "spin count"; }
+
+template <>
+std::string pretty_type<adaptive_futex_mutex_t>() { return "adaptive futex"; }
+
+template <>
+std::string pretty_type<owner_aware_mutex_t>() { return "owner aware"; }
+
+template <>
+std::string pretty_type<mcs_mutex_t>() { return "mcs"; }
+
+template <>
+std::string pretty_type<ticket_mutex_t>() { return "ticket"; }
+
+template <>
+std::string pretty_type<shared_spin_mutex_t>() { return "shared spin"; }
+
+template <>
+std::string pretty_type<adaptive_shared_spin_mutex_t>() { return "adaptive shared spin"; }
+
+template <>
+std::string pretty_type<shared_futex_mutex_t>() { return "shared futex"; }
+
+template <>
+std::string pretty_type<function_probe_t>() { return "function probe"; }
+
+template <>
+std::string pretty_type<policy::tas_t>() { return "tas"; }
+
+template <>
+std::string pretty_type<policy::ttas_t>() { return "ttas"; }
+
+template <>
+std::string pretty_type<policy::no_backoff_t>() { return "no backoff"; }
+
+template <>
+std::string pretty_type<policy::exponential_backoff_t>() { return "exp backoff"; }
+
+template <>
+std::string pretty_type<policy::proportional_backoff_t>() { return "prop backoff"; }
+
+template <>
+std::string pretty_type<policy::spin_wait_t>() { return "spin"; }
+
+template <>
+std::string pretty_type<policy::yield_wait_t>() { return "yield"; }
+
+template <>
+std::string pretty_type<policy::sleep_wait_t>() { return "sleep"; }
+
+template <>
+std::string pretty_type<policy::futex_wait_t>() { return "futex"; }
+
+template <>
+std::string pretty_type<policy::no_predictor_t>() { return "fixed"; }
+
+template <>
+std::string pretty_type<policy::ema_predictor_t<3>>() { return "ema"; }
+
+template <>
+std::string pretty_type<policy::thread_predictor_t<3>>() { return "thread ema"; }
+
+template <>
+std::string pretty_type<policy::spin_time_predictor_t<3>>() { return "spin time"; }
+
+template <>
+std::string pretty_type<stats_probe_t>() { return "stats"; }
+
+template <>
+std::string pretty_type<trace_probe_t>() { return "trace"; }
+
+// Names a benchmarked mutex type; class templates can be matched partially
+// where pretty_type cannot.
+template <typename T, typename = void>
+struct pretty_name {
+    static std::string get() { return pretty_type<T>(); }
+};
+
+template <typename Mutex, std::size_t N>
+struct pretty_name<striped_mutex<Mutex, N>> {
+    static std::string get() { return pretty_type<Mutex>() + " x" + std::to_string(N); }
+};
+
+// The mutex type a policy sweep runs; it only differs from basic_mutex in
+// being named after its policies.
+template <typename Spin, typename Backoff, typename Wait, typename Predictor>
+struct sweep_mutex : basic_mutex<Spin, Backoff, Wait, Predictor> { };
+
+template <typename Spin, typename Backoff, typename Wait, typename Predictor>
+struct pretty_name<sweep_mutex<Spin, Backoff, Wait, Predictor>> {
+    static std::string get() {
+        return pretty_type<Spin>() + "/" + pretty_type<Backoff>() + "/" +
+               pretty_type<Wait>() + "/" + pretty_type<Predictor>();
+    }
+};
+
+template <typename T, typename Mutex>
+struct pretty_name<synchronized<T, Mutex>> {
+    static std::string get() { return pretty_type<Mutex>() + " combining"; }
+};
+
+template <typename T>
+struct pretty_name<serial_wrapper<T>> {
+    static std::string get() { return "serial wrapper"; }
+};
+
+template <typename Mutex>
+struct pretty_name<basic_seqlock<Mutex>> {
+    static std::string get() { return pretty_type<Mutex>() + " versioned"; }
+};
+
+template <typename Mutex>
+struct pretty_name<Mutex, typename std::enable_if<!std::is_same<typename Mutex::probe_type,
+                                                                null_probe_t>::value>::type> {
+    static std::string get() {
+        return pretty_name<typename Mutex::template rebind_probe<null_probe_t>>::get() +
+               " (" + pretty_type<typename Mutex::probe_type>() + ")";
+    }
+};
+
 /******************************************************************************/
+// Read paths take a shared lock when the mutex supports one, and fall back to
+// an exclusive lock otherwise, so every mutex can run the same tests.
+
+template <typename Mutex, typename = void>
+struct read_lock {
+    using type = std::lock_guard<Mutex>;
+};
+
+template <typename Mutex>
+struct read_lock<Mutex, decltype(std::declval<Mutex&>().lock_shared())> {
+    using type = shared_lock_guard<Mutex>;
+};
 
-#if MUTEXPP_ENABLE_PROBE
+template <typename Mutex>
+using read_lock_t = typename read_lock<Mutex>::type;
 
 /******************************************************************************/
 
@@ -73,25 +246,25 @@ inline void probe_log(std::ofstream& out,
                       std::size_t&   n_total,
                       std::size_t&   n_blocked,
                       bool           did_block,
-                      duration_t     new_p,
-                      duration_t     new_b) {
+                      std::size_t    spin_count,
+                      duration_t     wait_time) {
     ++n_total;
 
     if (did_block)
         ++n_blocked;
 
     out << static_cast<int>(did_block)
-        << ',' << new_p.count()
-        << ',' << new_b.count()
+        << ',' << spin_count
+        << ',' << wait_time.count()
         << '\n';
 }
 
 /******************************************************************************/
 
 template <typename Mutex, std::size_t N>
-void n_slow_probe(bool       did_block,
-                  duration_t new_p,
-                  duration_t new_b) {
+void n_slow_probe(bool        did_block,
+                  std::size_t spin_count,
+                  duration_t  wait_time) {
     static std::ofstream out_s(pretty_type<Mutex>() + "_" +
                                std::to_string(N) +
                                "_slow.csv");
@@ -102,10 +275,10 @@ void n_slow_probe(bool       did_block,
     if (first_s) {
         first_s = false;
 
-        out_s << "blok_phas,spin (us),block (us)\n";
+        out_s << "blocked,spins,wait (us)\n";
     }
 
-    probe_log(out_s, n_total_s, n_blocked_s, did_block, new_p, new_b);
+    probe_log(out_s, n_total_s, n_blocked_s, did_block, spin_count, wait_time);
 }
 
 /******************************************************************************/
@@ -129,15 +302,17 @@ void n_slow_worker(Mutex& mutex, std::size_t i, std::size_t max) {
 
 template <typename Mutex, std::size_t N>
 void test_mutex_n_slow() {
+    using probed_t = typename Mutex::template rebind_probe<function_probe_t>;
+
     std::vector<std::thread> pool;
-    Mutex                    mutex;
+    probed_t                 mutex;
 
     mutex._probe = &n_slow_probe<Mutex, N>;
 
     std::cerr << pretty_type<Mutex>() << " " << N << " slow\n";
  
     for (std::size_t i(0); i < 5; ++i)
-        pool.emplace_back(n_slow_worker<Mutex>, std::ref(mutex), i, N);
+        pool.emplace_back(n_slow_worker<probed_t>, std::ref(mutex), i, N);
 
     for (auto& t : pool)
         t.join();
@@ -159,17 +334,17 @@ void mutex_benchmark_specific() {
 
 void mutex_benchmark() {
     mutex_benchmark_specific<spin_mutex_t>();
-    mutex_benchmark_specific<tbb::spin_mutex>();
+    mutex_benchmark_specific<ttas_spin_mutex_t>();
     mutex_benchmark_specific<adaptive_spin_mutex_t>();
     mutex_benchmark_specific<adaptive_block_mutex_t>();
+    mutex_benchmark_specific<adaptive_futex_mutex_t>();
+    mutex_benchmark_specific<owner_aware_mutex_t>();
+    mutex_benchmark_specific<mcs_mutex_t>();
+    mutex_benchmark_specific<ticket_mutex_t>();
 }
 
 /******************************************************************************/
 
-#endif // MUTEXPP_ENABLE_PROBE
-
-/******************************************************************************/
-
 struct map_insert_test_serial_t {
     std::future<void> run_once(serial_queue_t& q, std::size_t) {
         std::string key = std::to_string(std::rand());
@@ -241,13 +416,57 @@ struct map_search_test {
     void run_once(mutex_type& mutex, std::size_t) {
         std::string key = std::to_string(std::rand());
 
-        std::lock_guard<Mutex> lock(mutex);
+        read_lock_t<Mutex> lock(mutex);
         (void)map_m.find(key);
     }
 
     std::map<std::string, std::string> map_m;
 };
 
+/******************************************************************************/
+// map_insert_test's operation through a flat-combining synchronized map. The
+// synchronized the harness hands in only names the run; map_m persists across
+// runs, as map_insert_test's map does.
+
+template <typename Mutex>
+struct map_insert_test_synchronized {
+    using map_type = std::map<std::string, std::string>;
+    using mutex_type = synchronized<map_type, Mutex>;
+
+    explicit map_insert_test_synchronized(std::size_t) { }
+
+    void run_once(mutex_type&, std::size_t) {
+        std::string key = std::to_string(std::rand());
+        std::string value = std::to_string(std::rand());
+
+        map_m([&key, &value](map_type& map){
+            map[key] = value;
+        });
+    }
+
+    synchronized<map_type, Mutex> map_m;
+};
+
+// The same through a serial_wrapper, waiting on each operation as a
+// synchronized caller does.
+struct map_insert_test_wrapper_t {
+    using map_type = std::map<std::string, std::string>;
+    using mutex_type = serial_wrapper<map_type>;
+
+    explicit map_insert_test_wrapper_t(std::size_t) { }
+
+    void run_once(mutex_type&, std::size_t) {
+        std::string key = std::to_string(std::rand());
+        std::string value = std::to_string(std::rand());
+
+        map_m([key, value](map_type& map){
+            map[key] = value;
+        }).get();
+    }
+
+    serial_wrapper<map_type> map_m;
+};
+
 /******************************************************************************/
 
 template <std::size_t SlowThreshold, typename Mutex>
@@ -267,7 +486,7 @@ struct map_hybrid_test {
             std::lock_guard<Mutex> lock(mutex);
             map_m[key] = value;
         } else { // read group
-            std::lock_guard<Mutex> lock(mutex);
+            read_lock_t<Mutex> lock(mutex);
             (void)map_m.find(key);
         }
     }
@@ -276,28 +495,189 @@ struct map_hybrid_test {
     std::map<std::string, std::string> map_m;
 };
 
+/******************************************************************************/
+// Per-thread xorshift32. std::rand takes a lock in some C libraries, which
+// would be the very bottleneck the tests using this are trying to avoid.
+
+inline std::uint32_t fast_random() {
+    thread_local std::uint32_t x_s{static_cast<std::uint32_t>(std::rand()) | 1};
+
+    x_s ^= x_s << 13;
+    x_s ^= x_s >> 17;
+    x_s ^= x_s << 5;
+
+    return x_s;
+}
+
+/******************************************************************************/
+// A map split into Stripes shards, each guarded by its own stripe of a
+// striped_mutex. Most operations touch one key; every sixteenth moves a count
+// between two keys and so has to hold both of their stripes.
+
+template <std::size_t Stripes, typename Mutex>
+struct sharded_map_test {
+    using mutex_type = striped_mutex<Mutex, Stripes>;
+    using shard_type = std::map<std::size_t, std::size_t>;
+
+    explicit sharded_map_test(std::size_t) { }
+
+    static std::size_t random_key() { return fast_random() & 0xffff; }
+
+    shard_type& shard(std::size_t key) { return shards_m[mutex_type::stripe_of(key)]; }
+
+    void run_once(mutex_type& mutex, std::size_t) {
+        std::size_t key = random_key();
+
+        if (key % 16 == 0) {
+            std::size_t other = random_key();
+
+            striped_lock_guard<mutex_type> lock(mutex, { key, other });
+
+            ++shard(key)[key];
+            --shard(other)[other];
+        } else {
+            std::lock_guard<Mutex> lock(mutex.stripe_for(key));
+
+            ++shard(key)[key];
+        }
+    }
+
+    shard_type shards_m[Stripes];
+};
+
+/******************************************************************************/
+// A flat hash table of fixed-size buckets, one cache line each, trivially
+// copyable so it can sit behind a seqlock. Read-dominated: one operation in
+// write_one_in_k bumps a value, the rest look a key up. Every key in
+// [0, key_count_k) is present, in bucket key % bucket_count_k.
+
+struct flat_bucket_t {
+    enum : std::size_t { slot_count_k = 4 };
+
+    std::uint64_t keys_m[slot_count_k];
+    std::uint64_t values_m[slot_count_k];
+
+    std::uint64_t find(std::uint64_t key) const {
+        for (std::size_t i(0); i < slot_count_k; ++i)
+            if (keys_m[i] == key)
+                return values_m[i];
+
+        return 0;
+    }
+
+    void increment(std::uint64_t key) {
+        for (std::size_t i(0); i < slot_count_k; ++i)
+            if (keys_m[i] == key)
+                ++values_m[i];
+    }
+};
+
+struct flat_table_traits_t {
+    enum : std::size_t {
+        bucket_count_k = 1024,
+        key_count_k = bucket_count_k * flat_bucket_t::slot_count_k,
+        write_one_in_k = 64
+    };
+
+    static flat_bucket_t initial_bucket(std::size_t bucket_i) {
+        flat_bucket_t bucket;
+
+        for (std::size_t i(0); i < flat_bucket_t::slot_count_k; ++i) {
+            bucket.keys_m[i] = bucket_i + i * bucket_count_k;
+            bucket.values_m[i] = bucket.keys_m[i];
+        }
+
+        return bucket;
+    }
+
+    // Where lookups leave their results, so the reads cannot be optimized out.
+    static std::uint64_t& sink() {
+        thread_local std::uint64_t sink_s{0};
+
+        return sink_s;
+    }
+};
+
+// The table under one mutex, locked shared for lookups where the mutex can be.
+template <typename Mutex>
+struct flat_table_test : flat_table_traits_t {
+    using mutex_type = Mutex;
+
+    explicit flat_table_test(std::size_t) {
+        for (std::size_t i(0); i < bucket_count_k; ++i)
+            table_m[i] = initial_bucket(i);
+    }
+
+    void run_once(mutex_type& mutex, std::size_t) {
+        std::uint64_t  key = fast_random() % key_count_k;
+        flat_bucket_t& bucket = table_m[key % bucket_count_k];
+
+        if (fast_random() % write_one_in_k == 0) {
+            std::lock_guard<Mutex> lock(mutex);
+            bucket.increment(key);
+        } else {
+            read_lock_t<Mutex> lock(mutex);
+            sink() += bucket.find(key);
+        }
+    }
+
+    flat_bucket_t table_m[bucket_count_k];
+};
+
+// The same table with every bucket versioned: lookups are optimistic reads of
+// one bucket, and writers lock only the bucket they change. The seqlock the
+// harness hands in only names the run.
+template <typename Mutex>
+struct flat_table_versioned_test : flat_table_traits_t {
+    using mutex_type = basic_seqlock<Mutex>;
+
+    explicit flat_table_versioned_test(std::size_t) {
+        for (std::size_t i(0); i < bucket_count_k; ++i)
+            table_m[i].store(initial_bucket(i));
+    }
+
+    void run_once(mutex_type&, std::size_t) {
+        std::uint64_t                    key = fast_random() % key_count_k;
+        versioned<flat_bucket_t, Mutex>& bucket = table_m[key % bucket_count_k];
+
+        if (fast_random() % write_one_in_k == 0) {
+            bucket.update([key](flat_bucket_t& value){ value.increment(key); });
+        } else {
+            sink() += bucket.load().find(key);
+        }
+    }
+
+    versioned<flat_bucket_t, Mutex> table_m[bucket_count_k];
+};
+
 /******************************************************************************/
 
 template <typename Test>
 void run_test_instance(std::size_t thread_count, std::ostream& out) {
     using mutex_type = typename Test::mutex_type;
 
+    constexpr std::size_t inner_count_k{1000};
+
     std::vector<double> wall_times;
     std::vector<double> cpu_times;
+    std::vector<double> fairness;
     Test                test(thread_count);
 
     for (std::size_t test_i(0); test_i < 100; ++test_i) {
         mutex_type               mutex;
         std::vector<std::thread> pool;
+        std::vector<tp_t>        thread_ends(thread_count);
         std::atomic<bool>        go{false};
 
         for (std::size_t thread_i(0); thread_i < thread_count; ++thread_i) {
-            pool.emplace_back([&mutex, &test, &go, thread_i]() {
+            pool.emplace_back([&mutex, &test, &go, &thread_ends, thread_i]() {
                 while (!go); // spin here until we go.
 
-                for (std::size_t inner_i(0); inner_i < 1000; ++inner_i) {
+                for (std::size_t inner_i(0); inner_i < inner_count_k; ++inner_i) {
                     test.run_once(mutex, thread_i);
                 }
+
+                thread_ends[thread_i] = mutexpp::clock_t::now();
             });
         }
 
@@ -319,17 +699,31 @@ void run_test_instance(std::size_t thread_count, std::ostream& out) {
         constexpr double cpms_k{CLOCKS_PER_SEC/1000.}; // clocks per millisecond
         cpu_times.push_back((cpu_end - cpu_start) / cpms_k);
         }
+
+        // Every thread does the same amount of work, so an unfair mutex shows
+        // up as a spread in how long each thread took to get through it.
+        std::vector<double> throughputs;
+
+        for (const auto& thread_end : thread_ends)
+            throughputs.push_back(inner_count_k / duration_cast<duration<double, std::milli>>(thread_end - wall_start).count());
+
+        fairness.push_back(jain_fairness(throughputs));
     }
 
-    out << pretty_type<mutex_type>() << " wall"
+    out << pretty_name<mutex_type>::get() << " wall"
         << ","
         << normal_analysis(wall_times)
         << '\n';
 
-    out << pretty_type<mutex_type>() << " cpu"
+    out << pretty_name<mutex_type>::get() << " cpu"
         << ","
         << normal_analysis(cpu_times)
         << '\n';
+
+    out << pretty_name<mutex_type>::get() << " fairness"
+        << ","
+        << normal_analysis(fairness)
+        << '\n';
 }
 
 /******************************************************************************/
@@ -377,6 +771,46 @@ void run_test_instance_serial(std::ostream& out) {
         << '\n';
 }
 
+/******************************************************************************/
+// Measures how fast the executor chews through a backlog. Each run parks the
+// executor behind a gate task, queues `depth` tasks, then opens the gate and
+// times the drain, reporting tasks/second.
+
+template <typename Test>
+void run_test_instance_serial_depth(std::size_t depth, std::ostream& out) {
+    constexpr std::size_t test_count_k{20};
+
+    std::vector<double> rates;
+    Test                test;
+    serial_queue_t      q;
+
+    for (std::size_t test_i(0); test_i < test_count_k; ++test_i) {
+        std::promise<void>             gate;
+        std::shared_future<void>       gate_open(gate.get_future().share());
+        std::vector<std::future<void>> futures(depth);
+
+        q.async([gate_open](){ gate_open.wait(); });
+
+        for (std::size_t inner_i(0); inner_i < depth; ++inner_i) {
+            futures[inner_i] = test.run_once(q, inner_i);
+        }
+
+        tp_t wall_start = mutexpp::clock_t::now();
+
+        gate.set_value();
+
+        futures.back().get();
+
+        tp_t wall_end = mutexpp::clock_t::now();
+
+        rates.push_back(depth / duration_cast<duration<double>>(wall_end - wall_start).count());
+    }
+
+    out << "serial depth " << depth << " tasks/s,"
+        << normal_analysis(rates)
+        << '\n';
+}
+
 /******************************************************************************/
 
 template <template <typename> class Test>
@@ -386,8 +820,18 @@ void run_test_aggregate(const char* name, std::size_t thread_count, std::ostream
     run_test_instance<Test<tbb::mutex>>(thread_count, out);
     run_test_instance<Test<tbb::spin_mutex>>(thread_count, out);
     run_test_instance<Test<spin_mutex_t>>(thread_count, out);
+    run_test_instance<Test<ttas_spin_mutex_t>>(thread_count, out);
     run_test_instance<Test<adaptive_spin_mutex_t>>(thread_count, out);
+    run_test_instance<Test<spin_count_mutex_t>>(thread_count, out);
     run_test_instance<Test<adaptive_block_mutex_t>>(thread_count, out);
+    run_test_instance<Test<sleep_block_mutex_t>>(thread_count, out);
+    run_test_instance<Test<adaptive_futex_mutex_t>>(thread_count, out);
+    run_test_instance<Test<owner_aware_mutex_t>>(thread_count, out);
+    run_test_instance<Test<mcs_mutex_t>>(thread_count, out);
+    run_test_instance<Test<ticket_mutex_t>>(thread_count, out);
+    run_test_instance<Test<shared_spin_mutex_t>>(thread_count, out);
+    run_test_instance<Test<adaptive_shared_spin_mutex_t>>(thread_count, out);
+    run_test_instance<Test<shared_futex_mutex_t>>(thread_count, out);
 }
 
 /******************************************************************************/
@@ -413,64 +857,372 @@ using hybrid_50 = map_hybrid_test<50, Mutex>;
 template <class Mutex>
 using hybrid_75 = map_hybrid_test<75, Mutex>;
 
-void mutex_compare() {
-    run_test_aggregate<map_insert_test>("map_insert_test", std::cerr);
-    run_test_aggregate<map_search_test>("map_search_test", std::cerr);
-    run_test_aggregate<hybrid_25>("map_hybrid_25_test", std::cerr);
-    run_test_aggregate<hybrid_50>("map_hybrid_50_test", std::cerr);
-    run_test_aggregate<hybrid_75>("map_hybrid_75_test", std::cerr);
-}
+template <typename Mutex>
+void mutex_uncontended_instance() {
+    constexpr std::size_t count_k{1000000};
 
-/******************************************************************************/
+    Mutex mutex;
+    tp_t  start = mutexpp::clock_t::now();
 
-template <typename Test>
-void run_test_comprehensive_instance(std::ostream& out) {
-    static std::size_t max_threads_k = std::thread::hardware_concurrency() * 2;
+    for (std::size_t i(0); i < count_k; ++i) {
+        mutex.lock();
+        mutex.unlock();
+    }
 
-    out << "name,";
-    normal_analysis_header(out);
+    tp_t end = mutexpp::clock_t::now();
 
-    for (std::size_t i(1); i <= max_threads_k; ++i) {
-        run_test_instance<Test>(i, out);
-        out.flush();
-    }
+    std::cerr << pretty_name<Mutex>::get() << ": "
+              << duration_cast<duration<double, std::nano>>(end - start).count() / count_k
+              << " ns/uncontended lock\n";
 }
 
-/******************************************************************************/
+// Uncontended lock/unlock cost of each mutex with and without stats_probe_t,
+// side by side in the one binary, then a contended run of the instrumented
+// one with its counters and histograms.
 
-template <template <typename> class Test>
-void run_test_comprehensive(const char* name, std::ostream& out) {
-    out << name << '\n';
+template <typename Mutex>
+void mutex_stats_instance() {
+    using stats_mutex_t = typename Mutex::template rebind_probe<stats_probe_t>;
+
+    mutex_uncontended_instance<Mutex>();
+    mutex_uncontended_instance<stats_mutex_t>();
+
+    stats_mutex_t            mutex;
+    std::vector<std::thread> threads;
+    std::size_t              counter{0};
+
+    for (std::size_t thread_i(0); thread_i < (std::max)(thread_exact_k, std::size_t(2)); ++thread_i) {
+        threads.emplace_back([&mutex, &counter](){
+            for (std::size_t i(0); i < 100000; ++i) {
+                std::lock_guard<stats_mutex_t> lock(mutex);
+                ++counter;
+            }
+        });
+    }
 
-    run_test_comprehensive_instance<Test<tbb::mutex>>(out);
-    run_test_comprehensive_instance<Test<spin_mutex_t>>(out);
-    run_test_comprehensive_instance<Test<adaptive_spin_mutex_t>>(out);
-    run_test_comprehensive_instance<Test<adaptive_block_mutex_t>>(out);
-}
+    for (auto& thread : threads)
+        thread.join();
 
-/******************************************************************************/
+    lock_stats_t stats = mutex.stats();
 
-void mutex_comprehensive() {
-    std::ofstream out("comprehensive.csv");
+    std::cerr << "  acquisitions " << stats._acquisitions
+              << ", contended " << stats._contended
+              << ", spins " << stats._spins
+              << ", blocks " << stats._blocks << '\n';
 
-    run_test_comprehensive<map_insert_test>("map_insert_test", out);
-    run_test_instance_serial<map_insert_test_serial_t>(out);
-    run_test_instance_serial<map_search_test_serial_t>(out);
-}
+    auto print_histogram = [](const char* name, const std::uint64_t (&buckets)[lock_stats_t::bucket_count_k]) {
+        std::cerr << "  " << name << " (ns, log2 buckets):";
 
-/******************************************************************************/
+        for (std::size_t i(0); i < lock_stats_t::bucket_count_k; ++i)
+            if (buckets[i])
+                std::cerr << ' ' << (std::uint64_t(1) << i) << ':' << buckets[i];
 
-void serial_queue_test() {
-    std::ofstream out("serial_queue.csv");
+        std::cerr << '\n';
+    };
 
-    out << "name,";
-    normal_analysis_header(out);
+    print_histogram("wait", stats._wait_ns);
+    print_histogram("hold", stats._hold_ns);
+}
+
+void mutex_stats() {
+    mutex_stats_instance<spin_mutex_t>();
+    mutex_stats_instance<ttas_spin_mutex_t>();
+    mutex_stats_instance<adaptive_spin_mutex_t>();
+    mutex_stats_instance<adaptive_block_mutex_t>();
+    mutex_stats_instance<adaptive_futex_mutex_t>();
+    mutex_stats_instance<owner_aware_mutex_t>();
+    mutex_stats_instance<mcs_mutex_t>();
+    mutex_stats_instance<ticket_mutex_t>();
+    mutex_stats_instance<shared_spin_mutex_t>();
+    mutex_stats_instance<adaptive_shared_spin_mutex_t>();
+    mutex_stats_instance<shared_futex_mutex_t>();
+}
+
+// A short map_hybrid_test run on a traced mutex, plus some serial queue
+// traffic (whose events need MUTEXPP_ENABLE_TRACE), traced to mutexpp.trace.
+// Convert it with `mutexpp --chrome-trace mutexpp.trace out.json` and open the
+// result in chrome://tracing or Perfetto.
+
+void mutex_trace() {
+    run_test_instance<hybrid_50<adaptive_futex_mutex_t::rebind_probe<trace_probe_t>>>(thread_exact_k, std::cerr);
+
+    /* serial queue */ {
+        serial_queue_t q;
+
+        for (std::size_t i(0); i < 1000; ++i)
+            q.execute([](){ });
+    }
+
+    std::ofstream out("mutexpp.trace", std::ios::binary);
+
+    trace::dump(out);
+}
+
+/******************************************************************************/
+// What one read of each candidate clock costs, and how far cycle_clock_t
+// drifts from the steady clock over a short sleep.
+
+template <typename F>
+void clock_cost_instance(const char* name, F read) {
+    constexpr std::size_t count_k{10000000};
+
+    std::uint64_t sink{0};
+    auto          start = std::chrono::steady_clock::now();
+
+    for (std::size_t i(0); i < count_k; ++i)
+        sink += read();
+
+    auto end = std::chrono::steady_clock::now();
+
+    std::cerr << name << ": "
+              << duration_cast<duration<double, std::nano>>(end - start).count() / count_k
+              << " ns/read" << (sink == 42 ? " " : "") << '\n';
+}
+
+void clock_cost_test() {
+    auto count = [](std::chrono::nanoseconds d) { return static_cast<std::uint64_t>(d.count()); };
+
+    std::cerr << "cycle_clock_t "
+              << (cycle_clock_t::calibrated() ? "calibrated" : "falling back to steady_clock")
+              << '\n';
+
+    clock_cost_instance("cycle counter", [](){ return detail::cycle_count(); });
+    clock_cost_instance("cycle_clock_t", [&](){ return count(cycle_clock_t::now().time_since_epoch()); });
+    clock_cost_instance("steady_clock", [&](){ return count(std::chrono::steady_clock::now().time_since_epoch()); });
+    clock_cost_instance("high_resolution_clock", [&](){ return count(std::chrono::high_resolution_clock::now().time_since_epoch()); });
+    clock_cost_instance("system_clock", [&](){ return count(std::chrono::system_clock::now().time_since_epoch()); });
+
+    auto cycle_start = cycle_clock_t::now();
+    auto steady_start = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto cycle_elapsed = cycle_clock_t::now() - cycle_start;
+    auto steady_elapsed = std::chrono::steady_clock::now() - steady_start;
+
+    std::cerr << "drift over 100ms: "
+              << duration_cast<duration<double, std::micro>>(cycle_elapsed - steady_elapsed).count()
+              << " us\n";
+}
+
+/******************************************************************************/
+// spin_time_predictor_t fed waits of a known length and attempt count must
+// settle on a budget of twice the wait, in attempts, capped by the sleep
+// cost. Waits too short for the clock to see, as on a coarse counter, must
+// then bring it down, rather than shrinking the attempt cost to nothing and
+// the budget past any bound.
+
+void spin_time_predictor_test() {
+    constexpr std::size_t sample_count_k{200};
+    constexpr std::size_t attempt_count_k{1000};
+    constexpr double      wait_ns_k{5000};
+
+    policy::spin_time_predictor_t<3> predictor;
+
+    double sleep_ns = duration_cast<duration<double, std::nano>>(detail::sleep_cost()).count();
+    double expected = (std::min)(2 * wait_ns_k, sleep_ns) / (wait_ns_k / attempt_count_k);
+
+    for (std::size_t i(0); i < sample_count_k; ++i) {
+        predictor.spin_limit();
+
+        tp_t end = mutexpp::clock_t::now() + std::chrono::nanoseconds(std::int64_t(wait_ns_k));
+
+        while (mutexpp::clock_t::now() < end)
+            ;
+
+        predictor.acquired(attempt_count_k, false);
+    }
+
+    double limit = predictor.spin_limit();
+
+    std::cerr << "spin time budget: " << limit << " attempts, expected " << expected << '\n';
+
+    if (limit < expected * 0.75 || limit > expected * 1.25)
+        throw std::runtime_error("spin budget did not converge");
+
+    for (std::size_t i(0); i < sample_count_k; ++i) {
+        predictor.spin_limit();
+        predictor.acquired(std::size_t(-1), false);
+    }
+
+    if (predictor.spin_limit() >= limit) throw std::runtime_error("spin budget ignored short waits");
+}
+
+/******************************************************************************/
+
+template <class Mutex>
+using sharded_1 = sharded_map_test<1, Mutex>;
+template <class Mutex>
+using sharded_4 = sharded_map_test<4, Mutex>;
+template <class Mutex>
+using sharded_16 = sharded_map_test<16, Mutex>;
+template <class Mutex>
+using sharded_64 = sharded_map_test<64, Mutex>;
+
+void mutex_striped() {
+    run_test_aggregate<sharded_1>("sharded_map_test 1 stripe", std::cerr);
+    run_test_aggregate<sharded_4>("sharded_map_test 4 stripes", std::cerr);
+    run_test_aggregate<sharded_16>("sharded_map_test 16 stripes", std::cerr);
+    run_test_aggregate<sharded_64>("sharded_map_test 64 stripes", std::cerr);
+}
+
+/******************************************************************************/
+
+void mutex_versioned() {
+    run_test_aggregate<flat_table_test>("flat_table_test", std::cerr);
+
+    for (std::size_t thread_count : { thread_under_k, thread_exact_k, thread_over_k }) {
+        std::cerr << "flat_table_versioned_test " << thread_count << '/' << thread_exact_k << '\n';
+
+        run_test_instance<flat_table_versioned_test<spin_mutex_t>>(thread_count, std::cerr);
+        run_test_instance<flat_table_versioned_test<adaptive_futex_mutex_t>>(thread_count, std::cerr);
+    }
+}
+
+/******************************************************************************/
+
+void mutex_synchronized() {
+    run_test_aggregate<map_insert_test>("map_insert_test", std::cerr);
+
+    for (std::size_t thread_count : { thread_under_k, thread_exact_k, thread_over_k }) {
+        std::cerr << "map_insert_test_synchronized " << thread_count << '/' << thread_exact_k << '\n';
+
+        run_test_instance<map_insert_test_synchronized<spin_mutex_t>>(thread_count, std::cerr);
+        run_test_instance<map_insert_test_synchronized<adaptive_block_mutex_t>>(thread_count, std::cerr);
+        run_test_instance<map_insert_test_synchronized<adaptive_futex_mutex_t>>(thread_count, std::cerr);
+        run_test_instance<map_insert_test_wrapper_t>(thread_count, std::cerr);
+    }
+}
+
+/******************************************************************************/
+// Compile-time sweep over basic_mutex policies: runs Test once for every
+// combination drawn from the lists, one policy from each, in order.
+
+template <typename... Ts>
+struct type_list { };
+
+template <template <typename> class Test, typename Chosen, typename... Lists>
+struct mutex_sweep;
+
+template <template <typename> class Test, typename... Chosen>
+struct mutex_sweep<Test, type_list<Chosen...>> {
+    static void run(std::size_t thread_count, std::ostream& out) {
+        run_test_instance<Test<sweep_mutex<Chosen...>>>(thread_count, out);
+    }
+};
+
+template <template <typename> class Test, typename... Chosen, typename... Lists>
+struct mutex_sweep<Test, type_list<Chosen...>, type_list<>, Lists...> {
+    static void run(std::size_t, std::ostream&) { }
+};
+
+template <template <typename> class Test, typename... Chosen, typename Head, typename... Tail, typename... Lists>
+struct mutex_sweep<Test, type_list<Chosen...>, type_list<Head, Tail...>, Lists...> {
+    static void run(std::size_t thread_count, std::ostream& out) {
+        mutex_sweep<Test, type_list<Chosen..., Head>, Lists...>::run(thread_count, out);
+        mutex_sweep<Test, type_list<Chosen...>, type_list<Tail...>, Lists...>::run(thread_count, out);
+    }
+};
+
+template <template <typename> class Test>
+void run_test_sweep(const char* name, std::ostream& out) {
+    using spins_t = type_list<policy::tas_t, policy::ttas_t>;
+    using backoffs_t = type_list<policy::no_backoff_t,
+                                 policy::exponential_backoff_t,
+                                 policy::proportional_backoff_t>;
+    using waits_t = type_list<policy::spin_wait_t,
+                              policy::yield_wait_t,
+                              policy::sleep_wait_t,
+                              policy::futex_wait_t>;
+    using predictors_t = type_list<policy::no_predictor_t,
+                                   policy::ema_predictor_t<3>,
+                                   policy::thread_predictor_t<3>,
+                                   policy::spin_time_predictor_t<3>>;
+
+    out << "name,";
+    normal_analysis_header(out);
+
+    for (std::size_t thread_count : { thread_under_k, thread_exact_k, thread_over_k }) {
+        out << name << ' ' << thread_count << '/' << thread_exact_k << '\n';
+
+        mutex_sweep<Test, type_list<>, spins_t, backoffs_t, waits_t, predictors_t>::run(thread_count, out);
+
+        out.flush();
+    }
+}
+
+void mutex_sweep_policies() {
+    std::ofstream out("policy_sweep.csv");
+
+    run_test_sweep<hybrid_50>("map_hybrid_50_test", out);
+}
+
+/******************************************************************************/
+
+void mutex_compare() {
+    run_test_aggregate<map_insert_test>("map_insert_test", std::cerr);
+    run_test_aggregate<map_search_test>("map_search_test", std::cerr);
+    run_test_aggregate<hybrid_25>("map_hybrid_25_test", std::cerr);
+    run_test_aggregate<hybrid_50>("map_hybrid_50_test", std::cerr);
+    run_test_aggregate<hybrid_75>("map_hybrid_75_test", std::cerr);
+}
+
+/******************************************************************************/
+
+template <typename Test>
+void run_test_comprehensive_instance(std::ostream& out) {
+    static std::size_t max_threads_k = std::thread::hardware_concurrency() * 2;
+
+    out << "name,";
+    normal_analysis_header(out);
+
+    for (std::size_t i(1); i <= max_threads_k; ++i) {
+        run_test_instance<Test>(i, out);
+        out.flush();
+    }
+}
+
+/******************************************************************************/
+
+template <template <typename> class Test>
+void run_test_comprehensive(const char* name, std::ostream& out) {
+    out << name << '\n';
+
+    run_test_comprehensive_instance<Test<tbb::mutex>>(out);
+    run_test_comprehensive_instance<Test<spin_mutex_t>>(out);
+    run_test_comprehensive_instance<Test<adaptive_spin_mutex_t>>(out);
+    run_test_comprehensive_instance<Test<spin_count_mutex_t>>(out);
+    run_test_comprehensive_instance<Test<adaptive_block_mutex_t>>(out);
+    run_test_comprehensive_instance<Test<mcs_mutex_t>>(out);
+    run_test_comprehensive_instance<Test<ticket_mutex_t>>(out);
+}
+
+/******************************************************************************/
+
+void mutex_comprehensive() {
+    std::ofstream out("comprehensive.csv");
+
+    run_test_comprehensive<map_insert_test>("map_insert_test", out);
     run_test_instance_serial<map_insert_test_serial_t>(out);
     run_test_instance_serial<map_search_test_serial_t>(out);
 }
 
 /******************************************************************************/
 
+void serial_queue_test() {
+    std::ofstream out("serial_queue.csv");
+
+    out << "name,";
+    normal_analysis_header(out);
+    run_test_instance_serial<map_insert_test_serial_t>(out);
+    run_test_instance_serial<map_search_test_serial_t>(out);
+
+    for (std::size_t depth : { 1, 16, 256, 4096, 65536 })
+        run_test_instance_serial_depth<map_search_test_serial_t>(depth, out);
+}
+
+/******************************************************************************/
+
 void serial_wrapper_test() {
     typedef mutexpp::serial_wrapper<std::map<std::string, std::string>> serial_map_t;
 
@@ -541,21 +1293,705 @@ void serial_wrapper_test() {
     std::cerr << "nonserial: " << duration_cast<duration<double, std::milli>>(end - split).count() << '\n';
 }
 
+/******************************************************************************/
+// A three-stage pipeline across serial_wrappers, once with the producer
+// blocking on each stage's std::future before starting the next, and once
+// with the stages chained through mutexpp::future::then and a single
+// when_all at the end.
+
+void serial_pipeline_test() {
+    constexpr std::size_t count_k{10000};
+
+    typedef std::map<std::size_t, std::size_t> map_t;
+    typedef mutexpp::serial_wrapper<map_t>     serial_map_t;
+
+    serial_map_t stage1;
+    serial_map_t stage2;
+    serial_map_t stage3;
+    std::size_t  blocking_sum{0};
+    std::size_t  chained_sum{0};
+
+    tp_t start = mutexpp::clock_t::now();
+
+    for (std::size_t i(0); i < count_k; ++i) {
+        std::size_t a = stage1([i](map_t& map){ return ++map[i & 0xff]; }).get();
+        std::size_t b = stage2([a](map_t& map){ return map[a & 0xff] += a; }).get();
+
+        blocking_sum += stage3([b](map_t& map){ map[b & 0xff] = b; return b; }).get();
+    }
+
+    tp_t split = mutexpp::clock_t::now();
+
+    /* chained */ {
+        std::vector<mutexpp::future<std::size_t>> results;
+
+        results.reserve(count_k);
+
+        for (std::size_t i(0); i < count_k; ++i) {
+            results.push_back(submit(stage1, [i](map_t& map){ return ++map[i & 0xff]; })
+                              .then(stage2, [](map_t& map, std::size_t a){ return map[a & 0xff] += a; })
+                              .then(stage3, [](map_t& map, std::size_t b){ map[b & 0xff] = b; return b; }));
+        }
+
+        for (std::size_t result : when_all(std::move(results)).get())
+            chained_sum += result;
+    }
+
+    tp_t end = mutexpp::clock_t::now();
+
+    if (chained_sum == 0 || blocking_sum == 0)
+        throw std::runtime_error("pipeline produced nothing");
+
+    std::cerr << "pipeline, blocking: " << duration_cast<duration<double, std::milli>>(split - start).count() << " ms\n";
+    std::cerr << " pipeline, chained: " << duration_cast<duration<double, std::milli>>(end - split).count() << " ms\n";
+}
+
+/******************************************************************************/
+
+#if MUTEXPP_HAS_COROUTINES
+
+// Minimal fire-and-forget coroutine type; completion is signalled by the
+// coroutine body itself.
+struct detached_t {
+    struct promise_type {
+        detached_t get_return_object() { return detached_t(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { }
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+detached_t ping_pong(serial_queue_t& ping, serial_queue_t& pong, std::size_t count, std::promise<void>& done) {
+    for (std::size_t i(0); i < count; ++i) {
+        co_await ping.schedule();
+        co_await pong.schedule();
+    }
+
+    done.set_value();
+}
+
+detached_t async_mutex_worker(serial_queue_t&           q,
+                              async_mutex_t&            mutex,
+                              std::size_t&              counter,
+                              std::size_t               count,
+                              std::atomic<std::size_t>& remaining,
+                              std::promise<void>&       done) {
+    co_await q.schedule();
+
+    for (std::size_t i(0); i < count; ++i) {
+        co_await mutex.async_lock();
+        std::unique_lock<async_mutex_t> lock(mutex, std::adopt_lock);
+
+        ++counter;
+    }
+
+    if (remaining.fetch_sub(1) == 1)
+        done.set_value();
+}
+
+/******************************************************************************/
+// Round trips between two serial queues: a coroutine hopping from one to the
+// other with co_await schedule(), against a thread bouncing through async()
+// and blocking on each std::future. Then several coroutines on their own
+// queues contending for one async_mutex_t.
+
+void serial_coroutine_test() {
+    constexpr std::size_t count_k{100000};
+
+    // Declared ahead of the queues, so that the queues drain (and the
+    // coroutines finish signalling) before any of these go away.
+    std::promise<void>       ping_pong_done;
+    async_mutex_t            mutex;
+    std::size_t              counter{0};
+    std::atomic<std::size_t> remaining{0};
+    std::promise<void>       mutex_done;
+
+    serial_queue_t ping;
+    serial_queue_t pong;
+
+    tp_t start = mutexpp::clock_t::now();
+
+    ping_pong(ping, pong, count_k, ping_pong_done);
+
+    ping_pong_done.get_future().wait();
+
+    tp_t split = mutexpp::clock_t::now();
+
+    for (std::size_t i(0); i < count_k; ++i) {
+        ping.async([](){}).get();
+        pong.async([](){}).get();
+    }
+
+    tp_t end = mutexpp::clock_t::now();
+
+    auto per_trip_ns = [](tp_t start, tp_t end) {
+        return duration_cast<duration<double, std::nano>>(end - start).count() / count_k;
+    };
+
+    std::cerr << "ping-pong, coroutine: " << per_trip_ns(start, split) << " ns/round trip\n";
+    std::cerr << "   ping-pong, future: " << per_trip_ns(split, end) << " ns/round trip\n";
+
+    constexpr std::size_t worker_count_k{4};
+
+    std::vector<std::unique_ptr<serial_queue_t>> queues;
+
+    for (std::size_t i(0); i < worker_count_k; ++i)
+        queues.emplace_back(new serial_queue_t());
+
+    remaining = worker_count_k;
+
+    start = mutexpp::clock_t::now();
+
+    for (auto& q : queues)
+        async_mutex_worker(*q, mutex, counter, count_k, remaining, mutex_done);
+
+    mutex_done.get_future().wait();
+
+    end = mutexpp::clock_t::now();
+
+    if (counter != worker_count_k * count_k)
+        throw std::runtime_error("async_mutex_t lost an update");
+
+    std::cerr << "async mutex, " << worker_count_k << " coroutines: "
+              << duration_cast<duration<double, std::nano>>(end - start).count() / counter << " ns/lock\n";
+}
+
+#endif // MUTEXPP_HAS_COROUTINES
+
+/******************************************************************************/
+// Bursts of work submitted item by item against the same bursts submitted
+// through the batch entry points, fire-and-forget and with results.
+
+void serial_batch_test() {
+    constexpr std::size_t burst_count_k{100};
+    constexpr std::size_t burst_size_k{1000};
+    constexpr std::size_t item_count_k{burst_count_k * burst_size_k};
+
+    typedef mutexpp::serial_wrapper<std::map<std::size_t, std::size_t>> serial_map_t;
+
+    std::vector<std::size_t> burst(burst_size_k);
+
+    for (std::size_t i(0); i < burst_size_k; ++i)
+        burst[i] = i;
+
+    auto per_item_ns = [](tp_t start, tp_t end) {
+        return duration_cast<duration<double, std::nano>>(end - start).count() / item_count_k;
+    };
+
+    std::size_t counter{0};
+    tp_t        t0 = mutexpp::clock_t::now();
+
+    /* execute, item by item */ {
+        serial_queue_t q;
+
+        for (std::size_t burst_i(0); burst_i < burst_count_k; ++burst_i)
+            for (std::size_t item : burst)
+                q.execute([&counter, item](){ counter += item; });
+    }
+
+    tp_t t1 = mutexpp::clock_t::now();
+
+    /* execute_batch */ {
+        serial_queue_t q;
+
+        for (std::size_t burst_i(0); burst_i < burst_count_k; ++burst_i)
+            q.execute_batch(burst.begin(), burst.end(), [&counter](std::size_t item){ counter += item; });
+    }
+
+    tp_t t2 = mutexpp::clock_t::now();
+
+    /* async, item by item */ {
+        serial_queue_t                        q;
+        std::vector<std::future<std::size_t>> results;
+
+        results.reserve(burst_size_k);
+
+        for (std::size_t burst_i(0); burst_i < burst_count_k; ++burst_i) {
+            results.clear();
+
+            for (std::size_t item : burst)
+                results.push_back(q.async([item](){ return item * 2; }));
+
+            for (auto& result : results)
+                counter += result.get();
+        }
+    }
+
+    tp_t t3 = mutexpp::clock_t::now();
+
+    /* async_batch */ {
+        serial_queue_t q;
+
+        for (std::size_t burst_i(0); burst_i < burst_count_k; ++burst_i)
+            for (std::size_t result : q.async_batch(burst.begin(), burst.end(), [](std::size_t item){ return item * 2; }).get())
+                counter += result;
+    }
+
+    tp_t t4 = mutexpp::clock_t::now();
+
+    /* serial_wrapper post vs post_batch */ {
+        serial_map_t map;
+
+        for (std::size_t burst_i(0); burst_i < burst_count_k; ++burst_i)
+            for (std::size_t item : burst)
+                map.post([item](serial_map_t::value_type& m){ ++m[item]; });
+
+        map([](serial_map_t::value_type&){ }).get();
+    }
+
+    tp_t t5 = mutexpp::clock_t::now();
+
+    /* serial_wrapper post_batch */ {
+        serial_map_t map;
+
+        for (std::size_t burst_i(0); burst_i < burst_count_k; ++burst_i)
+            map.post_batch(burst.begin(), burst.end(), [](serial_map_t::value_type& m, std::size_t item){ ++m[item]; });
+
+        auto sizes = map.async_batch(burst.begin(), burst.begin() + 1, [](serial_map_t::value_type& m, std::size_t item){ return m[item]; }).get();
+
+        if (sizes.size() != 1 || sizes[0] != burst_count_k)
+            throw std::runtime_error("post_batch lost an update");
+    }
+
+    tp_t t6 = mutexpp::clock_t::now();
+
+    if (counter == 0)
+        throw std::runtime_error("batches did nothing");
+
+    std::cerr << "           execute: " << per_item_ns(t0, t1) << " ns/item\n";
+    std::cerr << "     execute_batch: " << per_item_ns(t1, t2) << " ns/item\n";
+    std::cerr << "             async: " << per_item_ns(t2, t3) << " ns/item\n";
+    std::cerr << "       async_batch: " << per_item_ns(t3, t4) << " ns/item\n";
+    std::cerr << "      wrapper post: " << per_item_ns(t4, t5) << " ns/item\n";
+    std::cerr << "wrapper post_batch: " << per_item_ns(t5, t6) << " ns/item\n";
+}
+
+/******************************************************************************/
+// Per-task enqueue+run cost of the future-returning entry points against their
+// fire-and-forget counterparts, for both serial_queue_t and serial_wrapper.
+
+void serial_execute_test() {
+    constexpr std::size_t count_k{100000};
+
+    typedef mutexpp::serial_wrapper<std::map<std::string, std::string>> serial_map_t;
+
+    auto per_task_ns = [](tp_t start, tp_t end) {
+        return duration_cast<duration<double, std::nano>>(end - start).count() / count_k;
+    };
+
+    std::size_t counter{0};
+    tp_t        start = mutexpp::clock_t::now();
+
+    /* async, result discarded */ {
+        serial_queue_t q;
+
+        for (std::size_t i(0); i < count_k; ++i)
+            q.async([&counter](){ ++counter; });
+
+        q.async([](){}).get();
+    }
+
+    tp_t split = mutexpp::clock_t::now();
+
+    /* execute */ {
+        serial_queue_t q;
+
+        for (std::size_t i(0); i < count_k; ++i)
+            q.execute([&counter](){ ++counter; });
+
+        q.async([](){}).get();
+    }
+
+    tp_t end = mutexpp::clock_t::now();
+
+    std::cerr << "  async: " << per_task_ns(start, split) << " ns/task\n";
+    std::cerr << "execute: " << per_task_ns(split, end) << " ns/task\n";
+
+    if (counter != 2 * count_k) throw std::runtime_error("unexpected task count");
+
+    start = mutexpp::clock_t::now();
+
+    /* serial_wrapper operator() */ {
+        serial_map_t serial_map;
+
+        for (std::size_t i(0); i < count_k; ++i) {
+            serial_map([i](serial_map_t::value_type& map){
+                map[std::to_string(i % 1000)] = "value";
+            });
+        }
+
+        serial_map([](serial_map_t::value_type&){ }).get();
+    }
+
+    split = mutexpp::clock_t::now();
+
+    /* serial_wrapper post() */ {
+        serial_map_t serial_map;
+
+        for (std::size_t i(0); i < count_k; ++i) {
+            serial_map.post([i](serial_map_t::value_type& map){
+                map[std::to_string(i % 1000)] = "value";
+            });
+        }
+
+        serial_map([](serial_map_t::value_type&){ }).get();
+    }
+
+    end = mutexpp::clock_t::now();
+
+    std::cerr << "wrapper (): " << per_task_ns(start, split) << " ns/task\n";
+    std::cerr << "    post(): " << per_task_ns(split, end) << " ns/task\n";
+}
+
+/******************************************************************************/
+// Allocations per task on the submitting thread and on the executor, counted
+// by the operator new replacement in allocation_count.cpp. A warm-up round
+// lets the task slot pool reach its steady-state size first.
+
+void serial_allocation_test() {
+    constexpr std::size_t count_k{100000};
+
+    serial_queue_t q;
+    std::size_t    counter{0};
+    std::string    small(8, 'x');
+
+    auto executor_count = [&q]() {
+        return q.async([](){ return allocation_count(); }).get();
+    };
+
+    auto report = [&](const char* name, std::size_t producer_n, std::size_t executor_n) {
+        std::cerr << name << ": "
+                  << static_cast<double>(producer_n) / count_k << " producer, "
+                  << static_cast<double>(executor_n) / count_k << " executor allocs/task\n";
+    };
+
+    for (std::size_t i(0); i < count_k; ++i)
+        q.execute([&counter](){ ++counter; });
+
+    std::size_t producer_start = allocation_count();
+    std::size_t executor_start = executor_count();
+
+    for (std::size_t i(0); i < count_k; ++i)
+        q.execute([&counter](){ ++counter; });
+
+    std::size_t producer_split = allocation_count();
+    std::size_t executor_split = executor_count();
+
+    report("execute, small capture", producer_split - producer_start, executor_split - executor_start);
+
+    // The async barrier tasks in executor_count() allocate on the producer
+    // side, so restart the producer count for each measurement.
+    producer_start = allocation_count();
+
+    for (std::size_t i(0); i < count_k; ++i)
+        q.execute([&counter, small](){ counter += small.size(); });
+
+    producer_split = allocation_count();
+    executor_start = executor_split;
+    executor_split = executor_count();
+
+    report("execute, string capture", producer_split - producer_start, executor_split - executor_start);
+
+    std::size_t oversized_count{0};
+
+    producer_start = allocation_count();
+
+    for (std::size_t i(0); i < count_k; ++i) {
+        std::array<char, 256> payload{};
+
+        q.execute([&oversized_count, payload](){ oversized_count += payload.size(); });
+    }
+
+    producer_split = allocation_count();
+    executor_start = executor_split;
+    executor_split = executor_count();
+
+    report("execute, oversized capture", producer_split - producer_start, executor_split - executor_start);
+
+    producer_start = allocation_count();
+
+    for (std::size_t i(0); i < count_k; ++i)
+        q.async([&counter](){ ++counter; });
+
+    producer_split = allocation_count();
+    executor_start = executor_split;
+    executor_split = executor_count();
+
+    report("async", producer_split - producer_start, executor_split - executor_start);
+}
+
+/******************************************************************************/
+// The portable serial_queue_t as it was before it moved onto worker_pool_t:
+// one dedicated thread per queue. Kept as a reference for serial_pool_test.
+
+class thread_serial_queue_t {
+    typedef std::unique_lock<std::mutex> lock_t;
+
+    std::mutex                        _mutex;
+    std::condition_variable           _ready;
+    std::deque<std::function<void()>> _queue;
+    bool                              _done{false};
+    std::thread                       _executor;
+
+    void run() {
+        while (true) {
+            lock_t lock(_mutex);
+
+            _ready.wait(lock, [this](){ return !_queue.empty() || _done; });
+
+            if (!_queue.empty()) {
+                std::function<void()> f = std::move(_queue.front());
+
+                _queue.pop_front();
+
+                lock.unlock();
+
+                f();
+            } else if (_done) {
+                break;
+            }
+        }
+    }
+
+public:
+    thread_serial_queue_t() :
+        _executor(&thread_serial_queue_t::run, this)
+    { }
+
+    ~thread_serial_queue_t() {
+        lock_t lock(_mutex);
+
+        _done = true;
+        lock.unlock();
+        _ready.notify_one();
+        _executor.join();
+    }
+
+    template <class Function>
+    void execute(Function&& f) {
+        lock_t lock(_mutex);
+
+        _queue.emplace_back(std::forward<Function>(f));
+
+        lock.unlock();
+
+        _ready.notify_one();
+    }
+};
+
+/******************************************************************************/
+
+std::size_t resident_bytes() {
+#if __linux__
+    std::ifstream statm("/proc/self/statm");
+    std::size_t   total_pages{0};
+    std::size_t   resident_pages{0};
+
+    statm >> total_pages >> resident_pages;
+
+    return resident_pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+/******************************************************************************/
+// Spreads a round of tasks over many queues at once, as one queue per actor
+// or resource would, reporting the time to run them all and the resident
+// memory each queue costs.
+
+template <typename Queue>
+void serial_pool_test_instance(const char* name, std::size_t queue_count) {
+    constexpr std::size_t tasks_per_queue_k{100};
+
+    std::atomic<std::size_t> remaining{queue_count * tasks_per_queue_k};
+    std::size_t              rss_start = resident_bytes();
+    std::size_t              rss_peak{0};
+    tp_t                     start = mutexpp::clock_t::now();
+
+    {
+        std::vector<std::unique_ptr<Queue>> queues;
+
+        try {
+            for (std::size_t i(0); i < queue_count; ++i)
+                queues.emplace_back(new Queue());
+        } catch (const std::system_error& error) {
+            std::cerr << name << ": gave up after " << queues.size()
+                      << " queues (" << error.what() << ")\n";
+            return;
+        }
+
+        for (std::size_t task_i(0); task_i < tasks_per_queue_k; ++task_i)
+            for (auto& queue : queues)
+                queue->execute([&remaining](){ remaining.fetch_sub(1, std::memory_order_relaxed); });
+
+        rss_peak = resident_bytes();
+
+        while (remaining.load(std::memory_order_relaxed))
+            std::this_thread::yield();
+    }
+
+    tp_t end = mutexpp::clock_t::now();
+
+    std::cerr << name << ", " << queue_count << " queues: "
+              << duration_cast<duration<double, std::milli>>(end - start).count() << " ms, "
+              << static_cast<double>(rss_peak - rss_start) / queue_count << " resident bytes/queue\n";
+}
+
+void serial_pool_test() {
+    for (std::size_t queue_count : { 100, 1000, 10000 }) {
+        serial_pool_test_instance<serial_queue_t>("worker pool", queue_count);
+        serial_pool_test_instance<thread_serial_queue_t>("thread per queue", queue_count);
+    }
+}
+
+/******************************************************************************/
+// A task that destroys a busy queue on a one-worker pool. The destructor runs
+// on the only worker, so it has to run the queue's tasks itself.
+
+void serial_pool_destroy_test() {
+    constexpr std::size_t count_k{1000};
+
+    worker_pool_t  pool(1);
+    serial_queue_t outer(pool);
+    std::size_t    counter{0};
+
+    outer.async([&pool, &counter](){
+        serial_queue_t inner(pool);
+
+        for (std::size_t i(0); i < count_k; ++i)
+            inner.execute([&counter](){ ++counter; });
+    }).get();
+
+    if (counter != count_k) throw std::runtime_error("unexpected task count");
+}
+
+/******************************************************************************/
+// Many independent map-backed resources on one pool, with requests spread
+// either evenly or skewed towards a handful of hot resources. Hot queues stay
+// busy while cold ones idle; stealing lets the idle workers pick the hot
+// queues' drain jobs up rather than sitting behind their own deques.
+
+void serial_steal_test_instance(std::size_t worker_count, bool skewed) {
+    typedef std::map<std::size_t, std::size_t> map_t;
+    typedef serial_wrapper<map_t>               wrapper_t;
+
+    constexpr std::size_t resource_count_k{256};
+    constexpr std::size_t producer_count_k{4};
+    constexpr std::size_t request_count_k{50000};
+
+    worker_pool_t                           pool(worker_count);
+    std::vector<std::unique_ptr<wrapper_t>> resources;
+    std::atomic<std::size_t>                remaining{producer_count_k * request_count_k};
+
+    for (std::size_t i(0); i < resource_count_k; ++i)
+        resources.emplace_back(new wrapper_t(pool));
+
+    tp_t start = mutexpp::clock_t::now();
+
+    std::vector<std::thread> producers;
+
+    for (std::size_t producer_i(0); producer_i < producer_count_k; ++producer_i) {
+        producers.emplace_back([&, producer_i](){
+            std::uint32_t x{static_cast<std::uint32_t>(producer_i * 2654435761u + 1)};
+
+            for (std::size_t i(0); i < request_count_k; ++i) {
+                x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+
+                // Cubing a uniform variate piles most requests onto the
+                // first few resources.
+                double      u = static_cast<double>(x) / 4294967296.0;
+                std::size_t index = static_cast<std::size_t>((skewed ? u * u * u : u) * resource_count_k);
+                std::size_t key = x & 0x3ff;
+
+                resources[index]->post([&remaining, key](map_t& map){
+                    ++map[key];
+                    remaining.fetch_sub(1, std::memory_order_relaxed);
+                });
+            }
+        });
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+
+    while (remaining.load(std::memory_order_relaxed))
+        std::this_thread::yield();
+
+    tp_t end = mutexpp::clock_t::now();
+
+    std::cerr << worker_count << " workers, " << (skewed ? "skewed" : "uniform") << ": "
+              << producer_count_k * request_count_k / duration_cast<duration<double>>(end - start).count()
+              << " requests/s\n";
+}
+
+void serial_steal_test() {
+    std::size_t hardware_count = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+    for (std::size_t worker_count : { std::size_t(1), hardware_count }) {
+        serial_steal_test_instance(worker_count, false);
+        serial_steal_test_instance(worker_count, true);
+    }
+}
+
 /******************************************************************************/
 
 int main(int argc, char** argv) {
+    if (argc == 4 && std::string(argv[1]) == "--chrome-trace") {
+        std::ifstream in(argv[2], std::ios::binary);
+        std::ofstream out(argv[3]);
+
+        trace::convert_to_chrome(in, out);
+
+        return 0;
+    }
+
     std::srand(static_cast<unsigned int>(std::time(nullptr)));
 
-#if MUTEXPP_ENABLE_PROBE
-    mutex_benchmark();
-#endif
+    //clock_cost_test();
+
+    //mutex_benchmark();
+
+    //mutex_trace();
+
     //mutex_compare();
 
+    //mutex_sweep_policies();
+
+    //mutex_striped();
+
+    //mutex_versioned();
+
+    //mutex_synchronized();
+
+    //mutex_stats();
+
     //mutex_comprehensive();
 
+    spin_time_predictor_test();
+
     serial_queue_test();
 
     serial_wrapper_test();
+
+    serial_execute_test();
+
+    serial_pipeline_test();
+
+    serial_batch_test();
+
+#if MUTEXPP_HAS_COROUTINES
+    serial_coroutine_test();
+#endif
+
+    serial_allocation_test();
+
+    serial_pool_destroy_test();
+
+    //serial_pool_test();
+
+    //serial_steal_test();
 }
 
 /******************************************************************************/